@@ -0,0 +1,180 @@
+#include "abr.h"
+
+#include <inttypes.h>
+#include <SDL2/SDL_timer.h>
+
+#include "lock_util.h"
+#include "log.h"
+
+// multiplicative decrease, in percent of the current bit-rate
+#define ABR_DECREASE_PERCENT 85
+// on overuse, do not request more than this ratio of the measured throughput
+#define ABR_THROUGHPUT_PERCENT 90
+// increase, in percent of the current bit-rate
+#define ABR_INCREASE_PERCENT 108
+
+static void window_reset(struct abr_window *window) {
+    window->bytes = 0;
+    window->packets = 0;
+    window->delay_sum = 0;
+    window->delay_min = 0;
+    window->skipped_frames = 0;
+}
+
+SDL_bool abr_init(struct abr *abr, Uint32 max_bit_rate, Uint32 target_delay) {
+    if (!(abr->mutex = SDL_CreateMutex())) {
+        return SDL_FALSE;
+    }
+    window_reset(&abr->window);
+    abr->min_bit_rate = ABR_MIN_BIT_RATE < max_bit_rate ? ABR_MIN_BIT_RATE
+                                                        : max_bit_rate;
+    abr->max_bit_rate = max_bit_rate;
+    abr->target_delay = target_delay;
+    abr->window_start = SDL_GetTicks();
+    abr->has_base_delay = SDL_FALSE;
+    abr->base_delay = 0;
+    abr->period_min_delay = 0;
+    abr->period_start = abr->window_start;
+    // the encoder starts at the max bit-rate
+    abr->stats.bit_rate = max_bit_rate;
+    abr->stats.throughput = 0;
+    abr->stats.queue_delay = 0;
+    abr->stats.increases = 0;
+    abr->stats.decreases = 0;
+    return SDL_TRUE;
+}
+
+void abr_destroy(struct abr *abr) {
+    LOGI("Adaptive bit-rate: %u increases, %u decreases, last %" PRIu32 " bps",
+         abr->stats.increases, abr->stats.decreases, abr->stats.bit_rate);
+    SDL_DestroyMutex(abr->mutex);
+}
+
+void abr_add_packet(struct abr *abr, uint64_t pts, size_t size, Uint32 now) {
+    // the clocks are different, only the variations of the delay matter
+    Sint64 delay = (Sint64) now - (Sint64) (pts / 1000);
+    mutex_lock(abr->mutex);
+    struct abr_window *window = &abr->window;
+    if (!window->packets || delay < window->delay_min) {
+        window->delay_min = delay;
+    }
+    window->bytes += size;
+    window->delay_sum += delay;
+    ++window->packets;
+    mutex_unlock(abr->mutex);
+}
+
+void abr_add_skipped_frame(struct abr *abr) {
+    mutex_lock(abr->mutex);
+    ++abr->window.skipped_frames;
+    mutex_unlock(abr->mutex);
+}
+
+Uint32 abr_compute_bit_rate(Uint32 bit_rate, Uint32 throughput,
+                            Uint32 queue_delay, SDL_bool backlog,
+                            Uint32 target_delay,
+                            Uint32 min_bit_rate, Uint32 max_bit_rate) {
+    Uint64 value = bit_rate;
+    if (queue_delay > target_delay || backlog) {
+        // overuse: the queues grow, drain them
+        value = value * ABR_DECREASE_PERCENT / 100;
+        Uint64 sustainable = (Uint64) throughput * ABR_THROUGHPUT_PERCENT / 100;
+        if (sustainable && sustainable < value) {
+            value = sustainable;
+        }
+    } else if (queue_delay < target_delay / 2 && throughput >= bit_rate / 2) {
+        // the queues are empty and the current bit-rate is actually used
+        // (on a static screen, the throughput tells nothing about the link)
+        value = value * ABR_INCREASE_PERCENT / 100;
+    }
+    if (value < min_bit_rate) {
+        value = min_bit_rate;
+    } else if (value > max_bit_rate) {
+        value = max_bit_rate;
+    }
+    return (Uint32) value;
+}
+
+static void update_base_delay(struct abr *abr, Sint64 window_min_delay,
+                              Uint32 now) {
+    if (!abr->has_base_delay) {
+        abr->has_base_delay = SDL_TRUE;
+        abr->base_delay = window_min_delay;
+        abr->period_min_delay = window_min_delay;
+        abr->period_start = now;
+        return;
+    }
+    if (now - abr->period_start >= ABR_BASE_DELAY_PERIOD_MS) {
+        // forget the minimum of the previous period, so that the baseline
+        // follows the clock drift and the route changes
+        abr->base_delay = abr->period_min_delay;
+        abr->period_min_delay = window_min_delay;
+        abr->period_start = now;
+    } else if (window_min_delay < abr->period_min_delay) {
+        abr->period_min_delay = window_min_delay;
+    }
+    if (window_min_delay < abr->base_delay) {
+        abr->base_delay = window_min_delay;
+    }
+}
+
+SDL_bool abr_update(struct abr *abr, Uint32 now, Uint32 *bit_rate) {
+    Uint32 elapsed = now - abr->window_start;
+    if (elapsed < ABR_INTERVAL_MS) {
+        return SDL_FALSE;
+    }
+
+    mutex_lock(abr->mutex);
+    struct abr_window window = abr->window;
+    window_reset(&abr->window);
+    mutex_unlock(abr->mutex);
+    abr->window_start = now;
+
+    if (!window.packets) {
+        // nothing received, nothing to measure
+        return SDL_FALSE;
+    }
+
+    update_base_delay(abr, window.delay_min, now);
+    Sint64 avg_delay = window.delay_sum / window.packets;
+    Uint32 queue_delay = (Uint32) (avg_delay - abr->base_delay);
+    Uint32 throughput = (Uint32) (window.bytes * 8 * 1000 / elapsed);
+    SDL_bool backlog = window.skipped_frames > 0;
+
+    abr->stats.throughput = throughput;
+    abr->stats.queue_delay = queue_delay;
+
+    Uint32 current = abr->stats.bit_rate;
+    Uint32 value = abr_compute_bit_rate(current, throughput, queue_delay,
+                                        backlog, abr->target_delay,
+                                        abr->min_bit_rate, abr->max_bit_rate);
+    LOGD("ABR: throughput %" PRIu32 " bps, queue delay %" PRIu32 " ms, "
+         "%u frames skipped", throughput, queue_delay, window.skipped_frames);
+    if (value == current) {
+        return SDL_FALSE;
+    }
+
+    if (value < current) {
+        ++abr->stats.decreases;
+    } else {
+        ++abr->stats.increases;
+    }
+    LOGI("ABR: bit-rate %" PRIu32 " -> %" PRIu32 " bps (throughput %" PRIu32
+         " bps, queue delay %" PRIu32 " ms, %u frames skipped)", current,
+         value, throughput, queue_delay, window.skipped_frames);
+    abr->stats.bit_rate = value;
+    *bit_rate = value;
+    return SDL_TRUE;
+}
+
+SDL_bool abr_set_max_bit_rate(struct abr *abr, Uint32 max_bit_rate) {
+    abr->max_bit_rate = max_bit_rate;
+    if (abr->min_bit_rate > max_bit_rate) {
+        abr->min_bit_rate = max_bit_rate;
+    }
+    if (abr->stats.bit_rate <= max_bit_rate) {
+        return SDL_FALSE;
+    }
+    abr->stats.bit_rate = max_bit_rate;
+    return SDL_TRUE;
+}
@@ -0,0 +1,88 @@
+#ifndef ABR_H
+#define ABR_H
+
+#include <stdint.h>
+#include <SDL2/SDL_mutex.h>
+#include <SDL2/SDL_stdinc.h>
+
+// Adaptive bit-rate.
+//
+// The decoder thread records, for every received packet, its size and its
+// one-way delay (receive time minus PTS, up to a constant clock offset). The
+// minimum delay observed recently is the baseline: the delay above it is the
+// time spent in queues (server writer, network, client socket).
+//
+// Periodically, the main thread computes the throughput and the queueing
+// delay, and steers the encoder bit-rate to keep the queueing delay below a
+// target: decrease multiplicatively on overuse (or if the decoder cannot keep
+// up), increase slowly when the queues are empty.
+
+// the period of the decisions
+#define ABR_INTERVAL_MS 500
+// the baseline is the minimum delay over the last 2 periods of this length
+#define ABR_BASE_DELAY_PERIOD_MS 10000
+#define ABR_DEFAULT_TARGET_DELAY_MS 100
+#define ABR_MIN_BIT_RATE 250000
+
+// observations of the decoder thread since the last decision
+struct abr_window {
+    Uint64 bytes;
+    unsigned packets;
+    Sint64 delay_sum; // ms
+    Sint64 delay_min; // ms, meaningful only if packets > 0
+    unsigned skipped_frames;
+};
+
+struct abr_stats {
+    Uint32 bit_rate; // requested to the encoder
+    Uint32 throughput; // bits/s received during the last interval
+    Uint32 queue_delay; // ms, average during the last interval
+    unsigned increases;
+    unsigned decreases;
+};
+
+struct abr {
+    SDL_mutex *mutex; // protects window
+    struct abr_window window;
+
+    // accessed by the main thread only
+    Uint32 min_bit_rate;
+    Uint32 max_bit_rate;
+    Uint32 target_delay; // ms
+    Uint32 window_start;
+    SDL_bool has_base_delay;
+    Sint64 base_delay; // minimum of the previous and current periods
+    Sint64 period_min_delay; // minimum of the current period
+    Uint32 period_start;
+    struct abr_stats stats;
+};
+
+SDL_bool abr_init(struct abr *abr, Uint32 max_bit_rate, Uint32 target_delay);
+void abr_destroy(struct abr *abr);
+
+// called by the decoder thread for every packet received
+// pts is in microseconds, now in milliseconds (SDL_GetTicks())
+void abr_add_packet(struct abr *abr, uint64_t pts, size_t size, Uint32 now);
+
+// called by the decoder thread when a decoded frame replaced a frame which had
+// not been rendered
+void abr_add_skipped_frame(struct abr *abr);
+
+// called by the main thread, return SDL_TRUE if the bit-rate must change (the
+// new value is written to bit_rate)
+SDL_bool abr_update(struct abr *abr, Uint32 now, Uint32 *bit_rate);
+
+// change the upper bound (the current bit-rate is lowered if necessary), to
+// be called by the main thread
+// return SDL_TRUE if the current bit-rate changed
+SDL_bool abr_set_max_bit_rate(struct abr *abr, Uint32 max_bit_rate);
+
+// the decision of one interval, exposed for testing
+// throughput is in bits/s, queue_delay and target_delay in ms
+// backlog is set if the decoder or the renderer cannot keep up
+Uint32 abr_compute_bit_rate(Uint32 bit_rate, Uint32 throughput,
+                            Uint32 queue_delay, SDL_bool backlog,
+                            Uint32 target_delay,
+                            Uint32 min_bit_rate, Uint32 max_bit_rate);
+
+#endif
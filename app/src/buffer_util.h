@@ -15,6 +15,24 @@ static inline void buffer_write32be(Uint8 *buf, Uint32 value) {
     buf[3] = value;
 }
 
+// write value as unsigned LEB128 (7 bits per byte, least significant group
+// first), return the number of bytes written (at most 5)
+static inline int buffer_write_uvarint(Uint8 *buf, Uint32 value) {
+    int i = 0;
+    while (value >= 0x80) {
+        buf[i++] = (value & 0x7f) | 0x80;
+        value >>= 7;
+    }
+    buf[i++] = value;
+    return i;
+}
+
+// write value zigzag-encoded (so that small negative values are short)
+static inline int buffer_write_varint(Uint8 *buf, Sint32 value) {
+    Uint32 zigzag = ((Uint32) value << 1) ^ (Uint32) -((Uint32) value >> 31);
+    return buffer_write_uvarint(buf, zigzag);
+}
+
 static inline Uint32 buffer_read32be(Uint8 *buf) {
     return (buf[0] << 24) | (buf[1] << 16) | (buf[2] << 8) | buf[3];
 }
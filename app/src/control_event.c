@@ -6,6 +6,7 @@
 #include "buffer_util.h"
 #include "lock_util.h"
 #include "log.h"
+#include "str_util.h"
 
 static void write_position(Uint8 *buf, const struct position *position) {
     buffer_write32be(&buf[0], position->point.x);
@@ -24,11 +25,10 @@ int control_event_serialize(const struct control_event *event, unsigned char *bu
             return 10;
         case CONTROL_EVENT_TYPE_TEXT: {
             // write length (2 bytes) + string (non nul-terminated)
-            size_t len = strlen(event->text_event.text);
-            if (len > TEXT_MAX_LENGTH) {
-                // injecting a text takes time, so limit the text length
-                len = TEXT_MAX_LENGTH;
-            }
+            // injecting a text takes time, so limit the text length (longer
+            // texts are split by the controller)
+            size_t len = utf8_truncation_index(event->text_event.text,
+                                               TEXT_MAX_LENGTH);
             buffer_write16be(&buf[1], (Uint16) len);
             memcpy(&buf[3], event->text_event.text, len);
             return 3 + len;
@@ -46,55 +46,312 @@ int control_event_serialize(const struct control_event *event, unsigned char *bu
         case CONTROL_EVENT_TYPE_COMMAND:
             buf[1] = event->command_event.action;
             return 2;
+        case CONTROL_EVENT_TYPE_VIDEO:
+            buffer_write32be(&buf[1], event->video_event.bit_rate);
+            buffer_write16be(&buf[5], event->video_event.max_size);
+            buffer_write16be(&buf[7], event->video_event.frame_rate);
+            return 9;
+        case CONTROL_EVENT_TYPE_REGION:
+            write_position(&buf[1], &event->region_event.position);
+            buffer_write16be(&buf[13], event->region_event.width);
+            buffer_write16be(&buf[15], event->region_event.height);
+            return 17;
         default:
             LOGW("Unknown event type: %u", (unsigned) event->type);
             return 0;
     }
 }
 
+void control_event_serializer_init(struct control_event_serializer *serializer,
+                                   int version) {
+    serializer->version = version;
+    serializer->screen_size.width = 0;
+    serializer->screen_size.height = 0;
+    serializer->point.x = 0;
+    serializer->point.y = 0;
+    serializer->timestamp = 0;
+}
+
+// write the screen size (if it changed) and the point delta
+static int write_position_v2(struct control_event_serializer *serializer,
+                             Uint8 *header, Uint8 *buf,
+                             const struct position *position) {
+    int i = 0;
+    if (position->screen_size.width != serializer->screen_size.width
+            || position->screen_size.height != serializer->screen_size.height) {
+        *header |= CONTROL_EVENT_V2_FLAG_SCREEN_SIZE;
+        i += buffer_write_uvarint(&buf[i], position->screen_size.width);
+        i += buffer_write_uvarint(&buf[i], position->screen_size.height);
+        serializer->screen_size = position->screen_size;
+    }
+    i += buffer_write_varint(&buf[i], position->point.x - serializer->point.x);
+    i += buffer_write_varint(&buf[i], position->point.y - serializer->point.y);
+    serializer->point = position->point;
+    return i;
+}
+
+static int serialize_v2(struct control_event_serializer *serializer,
+                        const struct control_event *event, unsigned char *buf) {
+    buf[0] = event->type;
+    int i = 1;
+    // events are not always sent in timestamp order (the key lane has
+    // priority), so the delta may be negative
+    i += buffer_write_varint(&buf[i], event->timestamp - serializer->timestamp);
+    serializer->timestamp = event->timestamp;
+    switch (event->type) {
+        case CONTROL_EVENT_TYPE_KEYCODE:
+            buf[i++] = event->keycode_event.action;
+            i += buffer_write_uvarint(&buf[i], event->keycode_event.keycode);
+            i += buffer_write_uvarint(&buf[i], event->keycode_event.metastate);
+            return i;
+        case CONTROL_EVENT_TYPE_TEXT: {
+            // injecting a text takes time, so limit the text length (longer
+            // texts are split by the controller)
+            size_t len = utf8_truncation_index(event->text_event.text,
+                                               TEXT_MAX_LENGTH);
+            i += buffer_write_uvarint(&buf[i], len);
+            memcpy(&buf[i], event->text_event.text, len);
+            return i + len;
+        }
+        case CONTROL_EVENT_TYPE_MOUSE:
+            buf[i++] = event->mouse_event.action;
+            i += buffer_write_uvarint(&buf[i], event->mouse_event.buttons);
+            i += write_position_v2(serializer, &buf[0], &buf[i],
+                                   &event->mouse_event.position);
+            return i;
+        case CONTROL_EVENT_TYPE_SCROLL:
+            i += write_position_v2(serializer, &buf[0], &buf[i],
+                                   &event->scroll_event.position);
+            i += buffer_write_varint(&buf[i], event->scroll_event.hscroll);
+            i += buffer_write_varint(&buf[i], event->scroll_event.vscroll);
+            return i;
+        case CONTROL_EVENT_TYPE_COMMAND:
+            buf[i++] = event->command_event.action;
+            return i;
+        case CONTROL_EVENT_TYPE_VIDEO:
+            i += buffer_write_uvarint(&buf[i], event->video_event.bit_rate);
+            i += buffer_write_uvarint(&buf[i], event->video_event.max_size);
+            i += buffer_write_uvarint(&buf[i], event->video_event.frame_rate);
+            return i;
+        case CONTROL_EVENT_TYPE_REGION:
+            i += write_position_v2(serializer, &buf[0], &buf[i],
+                                   &event->region_event.position);
+            i += buffer_write_uvarint(&buf[i], event->region_event.width);
+            i += buffer_write_uvarint(&buf[i], event->region_event.height);
+            return i;
+        default:
+            LOGW("Unknown event type: %u", (unsigned) event->type);
+            return 0;
+    }
+}
+
+int control_event_serializer_write(struct control_event_serializer *serializer,
+                                   const struct control_event *event,
+                                   unsigned char *buf) {
+    if (serializer->version == CONTROL_PROTOCOL_VERSION_2) {
+        return serialize_v2(serializer, event, buf);
+    }
+    return control_event_serialize(event, buf);
+}
+
 void control_event_destroy(struct control_event *event) {
     if (event->type == CONTROL_EVENT_TYPE_TEXT) {
         SDL_free(event->text_event.text);
     }
 }
 
+static SDL_bool lane_init(struct control_event_lane *lane) {
+    lane->data = SDL_malloc(CONTROL_EVENT_QUEUE_INITIAL_CAPACITY * sizeof(*lane->data));
+    if (!lane->data) {
+        return SDL_FALSE;
+    }
+    lane->capacity = CONTROL_EVENT_QUEUE_INITIAL_CAPACITY;
+    lane->head = 0;
+    lane->count = 0;
+    return SDL_TRUE;
+}
+
+static void lane_destroy(struct control_event_lane *lane) {
+    for (int i = 0; i < lane->count; ++i) {
+        control_event_destroy(&lane->data[(lane->head + i) % lane->capacity].event);
+    }
+    SDL_free(lane->data);
+}
+
+static inline struct control_event *lane_last(struct control_event_lane *lane) {
+    return &lane->data[(lane->head + lane->count - 1) % lane->capacity].event;
+}
+
+static SDL_bool lane_grow(struct control_event_lane *lane) {
+    int new_capacity = lane->capacity * 2;
+    if (new_capacity > CONTROL_EVENT_QUEUE_MAX_SIZE) {
+        new_capacity = CONTROL_EVENT_QUEUE_MAX_SIZE;
+    }
+    struct control_event_lane_entry *data =
+        SDL_malloc(new_capacity * sizeof(*data));
+    if (!data) {
+        LOGW("Could not grow control event queue");
+        return SDL_FALSE;
+    }
+    // unwrap the ring into the new buffer
+    for (int i = 0; i < lane->count; ++i) {
+        data[i] = lane->data[(lane->head + i) % lane->capacity];
+    }
+    SDL_free(lane->data);
+    lane->data = data;
+    lane->capacity = new_capacity;
+    lane->head = 0;
+    return SDL_TRUE;
+}
+
+static SDL_bool lane_push(struct control_event_lane *lane,
+                          const struct control_event *event, Uint32 barrier) {
+    if (lane->count == lane->capacity) {
+        if (lane->capacity == CONTROL_EVENT_QUEUE_MAX_SIZE || !lane_grow(lane)) {
+            return SDL_FALSE;
+        }
+    }
+    struct control_event_lane_entry *entry =
+        &lane->data[(lane->head + lane->count) % lane->capacity];
+    entry->event = *event;
+    entry->barrier = barrier;
+    ++lane->count;
+    return SDL_TRUE;
+}
+
+static SDL_bool lane_take(struct control_event_lane *lane,
+                          struct control_event *event) {
+    if (!lane->count) {
+        return SDL_FALSE;
+    }
+    *event = lane->data[lane->head].event;
+    lane->head = (lane->head + 1) % lane->capacity;
+    --lane->count;
+    return SDL_TRUE;
+}
+
 SDL_bool control_event_queue_is_empty(const struct control_event_queue *queue) {
-    return queue->head == queue->tail;
+    return !queue->key_lane.count && !queue->pointer_lane.count;
 }
 
 SDL_bool control_event_queue_is_full(const struct control_event_queue *queue) {
-    return (queue->head + 1) % CONTROL_EVENT_QUEUE_SIZE == queue->tail;
+    return queue->key_lane.count == CONTROL_EVENT_QUEUE_MAX_SIZE
+        || queue->pointer_lane.count == CONTROL_EVENT_QUEUE_MAX_SIZE;
 }
 
 SDL_bool control_event_queue_init(struct control_event_queue *queue) {
-    queue->head = 0;
-    queue->tail = 0;
-    // the current implementation may not fail
+    if (!lane_init(&queue->key_lane)) {
+        return SDL_FALSE;
+    }
+    if (!lane_init(&queue->pointer_lane)) {
+        SDL_free(queue->key_lane.data);
+        return SDL_FALSE;
+    }
+    queue->button_pushed_count = 0;
+    queue->button_taken_count = 0;
+    queue->coalesced_count = 0;
     return SDL_TRUE;
 }
 
 void control_event_queue_destroy(struct control_event_queue *queue) {
-    int i = queue->tail;
-    while (i != queue->head) {
-        control_event_destroy(&queue->data[i]);
-        i = (i + 1) % CONTROL_EVENT_QUEUE_SIZE;
+    lane_destroy(&queue->key_lane);
+    lane_destroy(&queue->pointer_lane);
+}
+
+static SDL_bool is_pointer(const struct control_event *event) {
+    return event->type == CONTROL_EVENT_TYPE_MOUSE
+        || event->type == CONTROL_EVENT_TYPE_SCROLL;
+}
+
+static SDL_bool is_mouse_move(const struct control_event *event) {
+    return event->type == CONTROL_EVENT_TYPE_MOUSE
+        && event->mouse_event.action == AMOTION_EVENT_ACTION_MOVE;
+}
+
+static SDL_bool is_motion(const struct control_event *event) {
+    return is_mouse_move(event) || event->type == CONTROL_EVENT_TYPE_SCROLL;
+}
+
+static inline SDL_bool size_equals(struct size a, struct size b) {
+    return a.width == b.width && a.height == b.height;
+}
+
+static inline SDL_bool position_equals(const struct position *a,
+                                       const struct position *b) {
+    return size_equals(a->screen_size, b->screen_size)
+        && a->point.x == b->point.x && a->point.y == b->point.y;
+}
+
+// merge event into last if possible (last is still queued, so it has not been
+// sent yet)
+static SDL_bool coalesce(struct control_event *last,
+                         const struct control_event *event) {
+    if (is_mouse_move(last) && is_mouse_move(event)
+            && last->mouse_event.buttons == event->mouse_event.buttons
+            && size_equals(last->mouse_event.position.screen_size,
+                           event->mouse_event.position.screen_size)) {
+        // the latest position wins
+        last->mouse_event.position = event->mouse_event.position;
+        last->timestamp = event->timestamp;
+        return SDL_TRUE;
+    }
+    if (last->type == CONTROL_EVENT_TYPE_SCROLL
+            && event->type == CONTROL_EVENT_TYPE_SCROLL
+            && position_equals(&last->scroll_event.position,
+                               &event->scroll_event.position)) {
+        last->scroll_event.hscroll += event->scroll_event.hscroll;
+        last->scroll_event.vscroll += event->scroll_event.vscroll;
+        last->timestamp = event->timestamp;
+        return SDL_TRUE;
     }
+    return SDL_FALSE;
 }
 
 SDL_bool control_event_queue_push(struct control_event_queue *queue, const struct control_event *event) {
-    if (control_event_queue_is_full(queue)) {
+    if (!is_pointer(event)) {
+        return lane_push(&queue->key_lane, event, queue->button_pushed_count);
+    }
+
+    struct control_event_lane *lane = &queue->pointer_lane;
+    if (lane->count && coalesce(lane_last(lane), event)) {
+        ++queue->coalesced_count;
+        return SDL_TRUE;
+    }
+    if (is_motion(event)
+            && CONTROL_EVENT_QUEUE_MAX_SIZE - lane->count <= CONTROL_EVENT_QUEUE_RESERVED_SLOTS) {
+        // keep the remaining slots for mouse button events
         return SDL_FALSE;
     }
-    queue->data[queue->head] = *event;
-    queue->head = (queue->head + 1) % CONTROL_EVENT_QUEUE_SIZE;
+    if (!lane_push(lane, event, 0)) {
+        return SDL_FALSE;
+    }
+    if (!is_motion(event)) {
+        ++queue->button_pushed_count;
+    }
     return SDL_TRUE;
 }
 
+// return SDL_TRUE if the oldest key lane event may be taken before the pointer
+// lane events
+static SDL_bool key_lane_ready(const struct control_event_queue *queue) {
+    const struct control_event_lane *lane = &queue->key_lane;
+    if (!lane->count) {
+        return SDL_FALSE;
+    }
+    // the counters may wrap
+    Uint32 barrier = lane->data[lane->head].barrier;
+    return (Sint32) (barrier - queue->button_taken_count) <= 0;
+}
+
 SDL_bool control_event_queue_take(struct control_event_queue *queue, struct control_event *event) {
-    if (control_event_queue_is_empty(queue)) {
+    if (key_lane_ready(queue)) {
+        return lane_take(&queue->key_lane, event);
+    }
+    if (!lane_take(&queue->pointer_lane, event)) {
         return SDL_FALSE;
     }
-    *event = queue->data[queue->tail];
-    queue->tail = (queue->tail + 1) % CONTROL_EVENT_QUEUE_SIZE;
+    if (!is_motion(event)) {
+        ++queue->button_taken_count;
+    }
     return SDL_TRUE;
 }
@@ -8,9 +8,28 @@
 #include "android/keycodes.h"
 #include "common.h"
 
-#define CONTROL_EVENT_QUEUE_SIZE 64
+// the queue grows on demand, up to CONTROL_EVENT_QUEUE_MAX_SIZE events per lane
+#define CONTROL_EVENT_QUEUE_INITIAL_CAPACITY 16
+#define CONTROL_EVENT_QUEUE_MAX_SIZE 1024
+// number of slots of the pointer lane that only mouse button events may use,
+// so that a burst of motion events never prevents a button release from being
+// queued
+#define CONTROL_EVENT_QUEUE_RESERVED_SLOTS 8
 #define TEXT_MAX_LENGTH 300
-#define SERIALIZED_EVENT_MAX_SIZE 3 + TEXT_MAX_LENGTH
+// the v2 header (type and timestamp) and text length may take up to 8 bytes
+#define SERIALIZED_EVENT_MAX_SIZE (8 + TEXT_MAX_LENGTH)
+
+// version 1: fixed-size fields, absolute positions
+// version 2: varints, relative positions, screen size only when it changes,
+//            client timestamp
+#define CONTROL_PROTOCOL_VERSION_1 1
+#define CONTROL_PROTOCOL_VERSION_2 2
+// the version requested to the server (which is always pushed by the client,
+// so it supports it)
+#define CONTROL_PROTOCOL_VERSION CONTROL_PROTOCOL_VERSION_2
+
+// v2 header flag, set when the screen size follows
+#define CONTROL_EVENT_V2_FLAG_SCREEN_SIZE 0x10
 
 enum control_event_type {
     CONTROL_EVENT_TYPE_KEYCODE,
@@ -18,12 +37,18 @@ enum control_event_type {
     CONTROL_EVENT_TYPE_MOUSE,
     CONTROL_EVENT_TYPE_SCROLL,
     CONTROL_EVENT_TYPE_COMMAND,
+    CONTROL_EVENT_TYPE_VIDEO,
+    CONTROL_EVENT_TYPE_REGION,
 };
 
 #define CONTROL_EVENT_COMMAND_BACK_OR_SCREEN_ON 0
+// stop encoding until resumed (the resume starts with a key frame)
+#define CONTROL_EVENT_COMMAND_PAUSE_VIDEO 1
+#define CONTROL_EVENT_COMMAND_RESUME_VIDEO 2
 
 struct control_event {
     enum control_event_type type;
+    Uint32 timestamp; // ms, SDL_GetTicks() time base (only sent in v2)
     union {
         struct {
             enum android_keyevent_action action;
@@ -46,26 +71,89 @@ struct control_event {
         struct {
             int action;
         } command_event;
+        // change the encoder settings, a value of 0 keeps the current one
+        struct {
+            Uint32 bit_rate;
+            Uint16 max_size;
+            Uint16 frame_rate;
+        } video_event;
+        // capture only a region of the current video (a size of 0 restores
+        // the initial crop)
+        struct {
+            struct position position; // the top-left corner
+            Uint16 width;
+            Uint16 height;
+        } region_event;
     };
 };
 
+struct control_event_lane_entry {
+    struct control_event event;
+    // for the key lane, the number of mouse button events pushed before this
+    // event, which must be taken before it
+    Uint32 barrier;
+};
+
+// growable ring buffer of events
+struct control_event_lane {
+    struct control_event_lane_entry *data;
+    int capacity;
+    int head; // index of the oldest event
+    int count;
+};
+
+// The queue has two lanes:
+//  - the key lane, for key, text and command events;
+//  - the pointer lane, for mouse and scroll events.
+// Each lane keeps strict order. Events are taken from the key lane first, so
+// that a key never waits behind high-rate motion events. Mouse button events
+// stay in the pointer lane, so they are never reordered relative to the
+// motion events around them, but they act as barriers for the key lane: a key
+// event pushed after a button event is taken after it (and after the motion
+// events queued before it), so that discrete input keeps strict order.
 struct control_event_queue {
-    struct control_event data[CONTROL_EVENT_QUEUE_SIZE];
-    int head;
-    int tail;
+    struct control_event_lane key_lane;
+    struct control_event_lane pointer_lane;
+    Uint32 button_pushed_count;
+    Uint32 button_taken_count;
+    unsigned coalesced_count; // events merged into an already queued event
+};
+
+// state of the v2 encoding, the values are relative to the previous event
+struct control_event_serializer {
+    int version;
+    struct size screen_size;
+    struct point point;
+    Uint32 timestamp;
 };
 
 // buf size must be at least SERIALIZED_EVENT_MAX_SIZE
 int control_event_serialize(const struct control_event *event, unsigned char *buf);
 
+void control_event_serializer_init(struct control_event_serializer *serializer,
+                                   int version);
+
+// serialize using the serializer protocol version (the state is updated)
+// buf size must be at least SERIALIZED_EVENT_MAX_SIZE
+int control_event_serializer_write(struct control_event_serializer *serializer,
+                                   const struct control_event *event,
+                                   unsigned char *buf);
+
 SDL_bool control_event_queue_init(struct control_event_queue *queue);
 void control_event_queue_destroy(struct control_event_queue *queue);
 
 SDL_bool control_event_queue_is_empty(const struct control_event_queue *queue);
+// return SDL_TRUE if at least one lane reached CONTROL_EVENT_QUEUE_MAX_SIZE
 SDL_bool control_event_queue_is_full(const struct control_event_queue *queue);
 
 // event is copied, the queue does not use the event after the function returns
+// a mouse move (resp. scroll) event may be merged into the last queued event
+// if it is also a mouse move with the same buttons (resp. a scroll at the
+// same position), in that case the queue length does not change
 SDL_bool control_event_queue_push(struct control_event_queue *queue, const struct control_event *event);
+// take the oldest event of the key lane, or of the pointer lane if the key
+// lane is empty or if its oldest event was pushed after a mouse button event
+// still queued
 SDL_bool control_event_queue_take(struct control_event_queue *queue, struct control_event *event);
 
 void control_event_destroy(struct control_event *event);
@@ -1,41 +1,65 @@
 #include "controller.h"
 
 #include <SDL2/SDL_assert.h>
+#include <SDL2/SDL_timer.h>
+#include <string.h>
 #include "config.h"
 #include "lock_util.h"
 #include "log.h"
+#include "str_util.h"
 
-SDL_bool controller_init(struct controller *controller, socket_t video_socket) {
+SDL_bool controller_init(struct controller *controller, socket_t control_socket,
+                         int protocol_version) {
     if (!control_event_queue_init(&controller->queue)) {
         return SDL_FALSE;
     }
 
     if (!(controller->mutex = SDL_CreateMutex())) {
+        control_event_queue_destroy(&controller->queue);
         return SDL_FALSE;
     }
 
     if (!(controller->event_cond = SDL_CreateCond())) {
         SDL_DestroyMutex(controller->mutex);
+        control_event_queue_destroy(&controller->queue);
         return SDL_FALSE;
     }
 
-    controller->video_socket = video_socket;
+    control_event_serializer_init(&controller->serializer, protocol_version);
+    controller->control_socket = control_socket;
     controller->stopped = SDL_FALSE;
+    controller->dropped_count = 0;
+    controller->sent_count = 0;
+    controller->write_count = 0;
+    controller->send_length = 0;
 
     return SDL_TRUE;
 }
 
 void controller_destroy(struct controller *controller) {
+    LOGD("Control events: %u sent in %u writes, %u coalesced, %u dropped",
+         controller->sent_count, controller->write_count,
+         controller->queue.coalesced_count, controller->dropped_count);
     SDL_DestroyCond(controller->event_cond);
     SDL_DestroyMutex(controller->mutex);
     control_event_queue_destroy(&controller->queue);
 }
 
 SDL_bool controller_push_event(struct controller *controller, const struct control_event *event) {
+    struct control_event timestamped = *event;
+    timestamped.timestamp = SDL_GetTicks();
+
     SDL_bool res;
     mutex_lock(controller->mutex);
     SDL_bool was_empty = control_event_queue_is_empty(&controller->queue);
-    res = control_event_queue_push(&controller->queue, event);
+    res = control_event_queue_push(&controller->queue, &timestamped);
+    if (!res) {
+        // do not flood the log: report the first drop, then every 256 drops
+        if (!controller->dropped_count++ || !(controller->dropped_count & 0xff)) {
+            LOGW("Control event queue full: %u events dropped (%u coalesced)",
+                 controller->dropped_count, controller->queue.coalesced_count);
+        }
+    }
     if (was_empty) {
         cond_signal(controller->event_cond);
     }
@@ -43,19 +67,110 @@ SDL_bool controller_push_event(struct controller *controller, const struct contr
     return res;
 }
 
-static SDL_bool process_event(struct controller *controller, const struct control_event *event) {
-    unsigned char serialized_event[SERIALIZED_EVENT_MAX_SIZE];
-    int length = control_event_serialize(event, serialized_event);
+static SDL_bool flush(struct controller *controller) {
+    if (!controller->send_length) {
+        return SDL_TRUE;
+    }
+    int length = controller->send_length;
+    controller->send_length = 0;
+    int w = net_send_all(controller->control_socket, controller->send_buffer, length);
+    ++controller->write_count;
+    return w == length;
+}
+
+// serialize the event into the send buffer, flushing it first if there is not
+// enough room (a blocking write naturally throttles long texts)
+static SDL_bool write_event(struct controller *controller,
+                            const struct control_event *event) {
+    if (controller->send_length + SERIALIZED_EVENT_MAX_SIZE > CONTROLLER_SEND_BUFFER_SIZE
+            && !flush(controller)) {
+        return SDL_FALSE;
+    }
+    int length = control_event_serializer_write(&controller->serializer, event,
+                                                &controller->send_buffer[controller->send_length]);
     if (!length) {
         return SDL_FALSE;
     }
-    int w = net_send_all(controller->video_socket, serialized_event, length);
-    return w == length;
+    controller->send_length += length;
+    ++controller->sent_count;
+    return SDL_TRUE;
+}
+
+static SDL_bool write_text_chunk(struct controller *controller, size_t len,
+                                 Uint32 timestamp) {
+    controller->text_chunk[len] = '\0';
+    struct control_event event = {
+        .type = CONTROL_EVENT_TYPE_TEXT,
+        .timestamp = timestamp,
+        .text_event = {
+            .text = controller->text_chunk,
+        },
+    };
+    return write_event(controller, &event);
+}
+
+// write the consecutive text events starting at events[*index] as text events
+// of at most TEXT_MAX_LENGTH bytes, split on UTF-8 char boundaries
+static SDL_bool write_texts(struct controller *controller,
+                            const struct control_event *events, int count,
+                            int *index) {
+    size_t chunk_len = 0;
+    Uint32 timestamp = events[*index].timestamp;
+    for (; *index < count && events[*index].type == CONTROL_EVENT_TYPE_TEXT;
+           ++*index) {
+        const char *text = events[*index].text_event.text;
+        size_t len = strlen(text);
+        while (len) {
+            size_t room = TEXT_MAX_LENGTH - chunk_len;
+            size_t n = len <= room ? len : utf8_truncation_index(text, room);
+            if (!n && !chunk_len) {
+                // invalid UTF-8, split anyway
+                n = room;
+            }
+            memcpy(&controller->text_chunk[chunk_len], text, n);
+            chunk_len += n;
+            text += n;
+            len -= n;
+            if (len) {
+                // the chunk is full
+                if (!write_text_chunk(controller, chunk_len, timestamp)) {
+                    return SDL_FALSE;
+                }
+                chunk_len = 0;
+                timestamp = events[*index].timestamp;
+            }
+        }
+    }
+    if (chunk_len && !write_text_chunk(controller, chunk_len, timestamp)) {
+        return SDL_FALSE;
+    }
+    return SDL_TRUE;
+}
+
+// serialize the events into the send buffer and write them at once
+static SDL_bool process_events(struct controller *controller,
+                               const struct control_event *events, int count) {
+    int i = 0;
+    while (i < count) {
+        if (events[i].type == CONTROL_EVENT_TYPE_TEXT) {
+            // advances i
+            if (!write_texts(controller, events, count, &i)) {
+                return SDL_FALSE;
+            }
+        } else {
+            if (!write_event(controller, &events[i])) {
+                return SDL_FALSE;
+            }
+            ++i;
+        }
+    }
+    return flush(controller);
 }
 
 static int run_controller(void *data) {
     struct controller *controller = data;
 
+    struct control_event events[CONTROLLER_MAX_BATCH];
     for (;;) {
         mutex_lock(controller->mutex);
         while (!controller->stopped && control_event_queue_is_empty(&controller->queue)) {
@@ -66,13 +181,20 @@ static int run_controller(void *data) {
             mutex_unlock(controller->mutex);
             break;
         }
-        struct control_event event;
-        SDL_bool non_empty = control_event_queue_take(&controller->queue, &event);
-        SDL_assert(non_empty);
+        // drain the queue, the remaining events and the events pushed
+        // meanwhile will be sent on the next iteration
+        int count = 0;
+        while (count < CONTROLLER_MAX_BATCH
+                && control_event_queue_take(&controller->queue, &events[count])) {
+            ++count;
+        }
+        SDL_assert(count);
         mutex_unlock(controller->mutex);
 
-        SDL_bool ok = process_event(controller, &event);
-        control_event_destroy(&event);
+        SDL_bool ok = process_events(controller, events, count);
+        for (int i = 0; i < count; ++i) {
+            control_event_destroy(&events[i]);
+        }
         if (!ok) {
             LOGD("Cannot write event to socket");
             break;
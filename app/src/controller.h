@@ -9,16 +9,33 @@
 
 #include "net.h"
 
+// the events taken from the queue on a wakeup (at most CONTROLLER_MAX_BATCH)
+// are sent in a single write, unless they do not fit in the send buffer (a
+// long text is split into several events)
+#define CONTROLLER_MAX_BATCH 64
+#define CONTROLLER_SEND_BUFFER_SIZE (CONTROLLER_MAX_BATCH * SERIALIZED_EVENT_MAX_SIZE)
+
 struct controller {
-    socket_t video_socket;
+    socket_t control_socket;
     SDL_Thread *thread;
     SDL_mutex *mutex;
     SDL_cond *event_cond;
     SDL_bool stopped;
+    unsigned dropped_count; // events rejected because the queue was full
+    unsigned sent_count; // events written to the socket
+    unsigned write_count; // socket writes
+    unsigned char send_buffer[CONTROLLER_SEND_BUFFER_SIZE];
+    int send_length;
+    // consecutive text events are merged, then split into chunks
+    char text_chunk[TEXT_MAX_LENGTH + 1];
     struct control_event_queue queue;
+    struct control_event_serializer serializer; // only used from the thread
 };
 
-SDL_bool controller_init(struct controller *controller, socket_t video_socket);
+// protocol_version is one of CONTROL_PROTOCOL_VERSION_*, as requested to the
+// server
+SDL_bool controller_init(struct controller *controller, socket_t control_socket,
+                         int protocol_version);
 void controller_destroy(struct controller *controller);
 
 SDL_bool controller_start(struct controller *controller);
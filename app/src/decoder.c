@@ -6,8 +6,11 @@
 #include <SDL2/SDL_events.h>
 #include <SDL2/SDL_mutex.h>
 #include <SDL2/SDL_thread.h>
+#include <SDL2/SDL_timer.h>
+#include <string.h>
 #include <unistd.h>
 
+#include "abr.h"
 #include "compat.h"
 #include "config.h"
 #include "buffer_util.h"
@@ -67,8 +70,8 @@ static int read_packet_with_meta(void *opaque, uint8_t *buf, int buf_size) {
     struct receiver_state *state = &decoder->receiver_state;
 
     // The video stream contains raw packets, without time information. When we
-    // record, we retrieve the timestamps separately, from a "meta" header
-    // added by the server before each raw packet.
+    // record (or adapt the bit-rate), we retrieve the timestamps separately,
+    // from a "meta" header added by the server before each raw packet.
     //
     // The "meta" header length is 12 bytes:
     // [. . . . . . . .|. . . .]. . . . . . . . . . . . . . . ...
@@ -93,8 +96,11 @@ static int read_packet_with_meta(void *opaque, uint8_t *buf, int buf_size) {
 
         uint64_t pts = buffer_read64be(header);
         state->remaining = buffer_read32be(&header[8]);
+        state->pts = pts;
+        state->packet_size = state->remaining;
 
-        if (pts != NO_PTS && !receiver_state_push_meta(state, pts)) {
+        if (pts != NO_PTS && decoder->recorder
+                && !receiver_state_push_meta(state, pts)) {
             LOGE("Could not store PTS for recording");
             // we cannot save the PTS, the recording would be broken
             return AVERROR(ENOMEM);
@@ -117,6 +123,12 @@ static int read_packet_with_meta(void *opaque, uint8_t *buf, int buf_size) {
     SDL_assert(state->remaining >= r);
     state->remaining -= r;
 
+    if (!state->remaining && decoder->abr && state->pts != NO_PTS) {
+        // the whole packet is received
+        abr_add_packet(decoder->abr, state->pts, state->packet_size,
+                       SDL_GetTicks());
+    }
+
     return r;
 }
 
@@ -132,10 +144,66 @@ static int read_raw_packet(void *opaque, uint8_t *buf, int buf_size) {
     return r;
 }
 
+#define CHECKSUM_PRIME UINT64_C(0x100000001b3)
+
+static inline Uint64 checksum_mix(Uint64 hash, Uint64 value) {
+    return (hash ^ value) * CHECKSUM_PRIME;
+}
+
+// hash a plane row by row (the padding between rows is ignored)
+// the words are hashed in 4 independent lanes, which breaks the dependency
+// chain of the multiplications so that they may execute in parallel
+static Uint64 checksum_plane(Uint64 hash, const uint8_t *data, int linesize,
+                             int width, int height) {
+    Uint64 lanes[4] = {hash, hash + 1, hash + 2, hash + 3};
+    for (int y = 0; y < height; ++y) {
+        const uint8_t *row = data + (size_t) y * linesize;
+        int x = 0;
+        for (; x + 32 <= width; x += 32) {
+            Uint64 words[4];
+            memcpy(words, &row[x], sizeof(words));
+            for (int i = 0; i < 4; ++i) {
+                lanes[i] = checksum_mix(lanes[i], words[i]);
+            }
+        }
+        for (; x < width; ++x) {
+            lanes[0] = checksum_mix(lanes[0], row[x]);
+        }
+    }
+    for (int i = 0; i < 4; ++i) {
+        hash = checksum_mix(hash, lanes[i]);
+    }
+    return hash;
+}
+
+// compute a checksum of the YUV 4:2:0 frame content, to detect frames which do
+// not change the picture (on idle screens, the encoder repeats the previous
+// frame, see KEY_REPEAT_PREVIOUS_FRAME_AFTER on the server side)
+static Uint64 frame_checksum(const AVFrame *frame) {
+    Uint64 hash = UINT64_C(0xcbf29ce484222325);
+    hash = checksum_mix(hash, ((Uint64) frame->width << 32) | frame->height);
+    int chroma_width = (frame->width + 1) / 2;
+    int chroma_height = (frame->height + 1) / 2;
+    hash = checksum_plane(hash, frame->data[0], frame->linesize[0],
+                          frame->width, frame->height);
+    hash = checksum_plane(hash, frame->data[1], frame->linesize[1],
+                          chroma_width, chroma_height);
+    hash = checksum_plane(hash, frame->data[2], frame->linesize[2],
+                          chroma_width, chroma_height);
+    return hash;
+}
+
 // set the decoded frame as ready for rendering, and notify
 static void push_frame(struct decoder *decoder) {
+    // the decoding frame is owned by the decoder thread, no need to lock
+    decoder->frames->decoding_frame_checksum =
+            frame_checksum(decoder->frames->decoding_frame);
     SDL_bool previous_frame_consumed = frames_offer_decoded_frame(decoder->frames);
     if (!previous_frame_consumed) {
+        if (decoder->abr) {
+            // the rendering cannot keep up
+            abr_add_skipped_frame(decoder->abr);
+        }
         // the previous EVENT_NEW_FRAME will consume this frame
         return;
     }
@@ -154,9 +222,9 @@ static void notify_stopped(void) {
 static int run_decoder(void *data) {
     struct decoder *decoder = data;
 
-    AVCodec *codec = avcodec_find_decoder(AV_CODEC_ID_H264);
+    AVCodec *codec = avcodec_find_decoder(decoder->codec_id);
     if (!codec) {
-        LOGE("H.264 decoder not found");
+        LOGE("Decoder not found: %s", avcodec_get_name(decoder->codec_id));
         goto run_end;
     }
 
@@ -167,7 +235,7 @@ static int run_decoder(void *data) {
     }
 
     if (avcodec_open2(codec_ctx, codec, NULL) < 0) {
-        LOGE("Could not open H.264 codec");
+        LOGE("Could not open %s codec", codec->name);
         goto run_finally_free_codec_ctx;
     }
 
@@ -187,9 +255,11 @@ static int run_decoder(void *data) {
     decoder->receiver_state.frame_meta_queue = NULL;
     decoder->receiver_state.remaining = 0;
 
-    // if recording is enabled, a "header" is sent between raw packets
+    // if recording or adaptive bit-rate is enabled, a "header" is sent between
+    // raw packets
     int (*read_packet)(void *, uint8_t *, int) =
-            decoder->recorder ? read_packet_with_meta : read_raw_packet;
+            decoder->recorder || decoder->abr ? read_packet_with_meta
+                                              : read_raw_packet;
     AVIOContext *avio_ctx = avio_alloc_context(buffer, BUFSIZE, 0, decoder,
                                                read_packet, NULL, NULL);
     if (!avio_ctx) {
@@ -299,10 +369,13 @@ run_end:
 }
 
 void decoder_init(struct decoder *decoder, struct frames *frames,
-                  socket_t video_socket, struct recorder *recorder) {
+                  socket_t video_socket, enum AVCodecID codec_id,
+                  struct recorder *recorder, struct abr *abr) {
     decoder->frames = frames;
     decoder->video_socket = video_socket;
+    decoder->codec_id = codec_id;
     decoder->recorder = recorder;
+    decoder->abr = abr;
 }
 
 SDL_bool decoder_start(struct decoder *decoder) {
@@ -1,12 +1,14 @@
 #ifndef DECODER_H
 #define DECODER_H
 
+#include <libavcodec/avcodec.h>
 #include <SDL2/SDL_stdinc.h>
 #include <SDL2/SDL_thread.h>
 
 #include "common.h"
 #include "net.h"
 
+struct abr;
 struct frames;
 
 struct frame_meta {
@@ -17,18 +19,24 @@ struct frame_meta {
 struct decoder {
     struct frames *frames;
     socket_t video_socket;
+    enum AVCodecID codec_id;
     SDL_Thread *thread;
     SDL_mutex *mutex;
     struct recorder *recorder;
+    struct abr *abr; // NULL if the bit-rate is not adaptive
     struct receiver_state {
         // meta (in order) for frames not consumed yet
         struct frame_meta *frame_meta_queue;
         size_t remaining; // remaining bytes to receive for the current frame
+        // meta of the current packet, for the adaptive bit-rate
+        uint64_t pts;
+        size_t packet_size;
     } receiver_state;
 };
 
 void decoder_init(struct decoder *decoder, struct frames *frames,
-                  socket_t video_socket, struct recorder *recoder);
+                  socket_t video_socket, enum AVCodecID codec_id,
+                  struct recorder *recoder, struct abr *abr);
 SDL_bool decoder_start(struct decoder *decoder);
 void decoder_stop(struct decoder *decoder);
 void decoder_join(struct decoder *decoder);
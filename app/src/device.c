@@ -1,18 +1,59 @@
 #include "device.h"
+
+#include <string.h>
+
+#include "handshake.h"
 #include "log.h"
 
-SDL_bool device_read_info(socket_t device_socket, char *device_name, struct size *size) {
-    unsigned char buf[DEVICE_NAME_FIELD_LENGTH + 4];
-    int r = net_recv_all(device_socket, buf, sizeof(buf));
-    if (r < DEVICE_NAME_FIELD_LENGTH + 4) {
-        LOGE("Could not retrieve device information");
+static const char *const codec_names[] = {
+    [DEVICE_CODEC_H264] = "h264",
+    [DEVICE_CODEC_H265] = "h265",
+};
+
+const char *device_codec_name(enum device_codec codec) {
+    return codec_names[codec];
+}
+
+SDL_bool device_codec_from_name(const char *name, enum device_codec *codec) {
+    for (size_t i = 0; i < ARRAY_LEN(codec_names); ++i) {
+        if (!strcmp(name, codec_names[i])) {
+            *codec = (enum device_codec) i;
+            return SDL_TRUE;
+        }
+    }
+    return SDL_FALSE;
+}
+
+SDL_bool device_send_options(socket_t control_socket,
+                             const struct handshake_options *options) {
+    unsigned char buf[HANDSHAKE_MAX_OPTIONS_LENGTH];
+    size_t len = handshake_serialize_options(options, buf);
+    if (!len) {
+        return SDL_FALSE;
+    }
+    if (net_send_all(control_socket, buf, len) != (ssize_t) len) {
+        LOGE("Could not send the options to the device");
         return SDL_FALSE;
     }
-    buf[DEVICE_NAME_FIELD_LENGTH - 1] = '\0'; // in case the client sends garbage
-    // strcpy is safe here, since name contains at least DEVICE_NAME_FIELD_LENGTH bytes
-    // and strlen(buf) < DEVICE_NAME_FIELD_LENGTH
-    strcpy(device_name, (char *) buf);
-    size->width = (buf[DEVICE_NAME_FIELD_LENGTH] << 8) | buf[DEVICE_NAME_FIELD_LENGTH + 1];
-    size->height = (buf[DEVICE_NAME_FIELD_LENGTH + 2] << 8) | buf[DEVICE_NAME_FIELD_LENGTH + 3];
     return SDL_TRUE;
 }
+
+SDL_bool device_read_info(socket_t video_socket, struct device_info *info) {
+    unsigned char header[HANDSHAKE_HEADER_LENGTH];
+    int r = net_recv_all(video_socket, header, sizeof(header));
+    if (r < HANDSHAKE_HEADER_LENGTH) {
+        LOGE("Could not retrieve device information");
+        return SDL_FALSE;
+    }
+    Uint16 len;
+    if (!handshake_parse_header(header, &len)) {
+        return SDL_FALSE;
+    }
+    unsigned char payload[HANDSHAKE_MAX_PAYLOAD_LENGTH];
+    r = net_recv_all(video_socket, payload, len);
+    if (r < len) {
+        LOGE("Could not retrieve device information");
+        return SDL_FALSE;
+    }
+    return handshake_parse_device_info(payload, len, info);
+}
@@ -9,7 +9,34 @@
 #define DEVICE_NAME_FIELD_LENGTH 64
 #define DEVICE_SDCARD_PATH "/sdcard/"
 
-// name must be at least DEVICE_NAME_FIELD_LENGTH bytes
-SDL_bool device_read_info(socket_t device_socket, char *name, struct size *frame_size);
+// the video codecs, with the ids sent by the server in the device info
+enum device_codec {
+    DEVICE_CODEC_H264 = 0,
+    DEVICE_CODEC_H265 = 1,
+};
+
+// the name passed to the server
+const char *device_codec_name(enum device_codec codec);
+SDL_bool device_codec_from_name(const char *name, enum device_codec *codec);
+
+struct handshake_options;
+
+struct device_info {
+    char device_name[DEVICE_NAME_FIELD_LENGTH];
+    struct size frame_size;
+    // the codec actually used by the server (it may not support the requested
+    // one)
+    enum device_codec codec;
+    // the control protocol version accepted by the server
+    Uint8 control_protocol_version;
+    Uint32 capabilities; // HANDSHAKE_CAPABILITY_* flags
+};
+
+// send the client hello on the control socket
+SDL_bool device_send_options(socket_t control_socket,
+                             const struct handshake_options *options);
+
+// read the server hello on the video socket
+SDL_bool device_read_info(socket_t video_socket, struct device_info *info);
 
 #endif
@@ -1,3 +1,4 @@
 #define EVENT_NEW_SESSION SDL_USEREVENT
 #define EVENT_NEW_FRAME (SDL_USEREVENT + 1)
 #define EVENT_DECODER_STOPPED (SDL_USEREVENT + 2)
+#define EVENT_VIDEO_SIZE_REQUEST (SDL_USEREVENT + 3)
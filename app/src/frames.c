@@ -33,6 +33,7 @@ SDL_bool frames_init(struct frames *frames) {
     // there is initially no rendering frame, so consider it has already been
     // consumed
     frames->rendering_frame_consumed = SDL_TRUE;
+    frames->has_consumed_frame = SDL_FALSE;
     fps_counter_init(&frames->fps_counter);
 
     return SDL_TRUE;
@@ -58,6 +59,10 @@ static void frames_swap(struct frames *frames) {
     AVFrame *tmp = frames->decoding_frame;
     frames->decoding_frame = frames->rendering_frame;
     frames->rendering_frame = tmp;
+
+    Uint64 tmp_checksum = frames->decoding_frame_checksum;
+    frames->decoding_frame_checksum = frames->rendering_frame_checksum;
+    frames->rendering_frame_checksum = tmp_checksum;
 }
 
 SDL_bool frames_offer_decoded_frame(struct frames *frames) {
@@ -86,6 +91,8 @@ SDL_bool frames_offer_decoded_frame(struct frames *frames) {
 const AVFrame *frames_consume_rendered_frame(struct frames *frames) {
     SDL_assert(!frames->rendering_frame_consumed);
     frames->rendering_frame_consumed = SDL_TRUE;
+    frames->consumed_frame_checksum = frames->rendering_frame_checksum;
+    frames->has_consumed_frame = SDL_TRUE;
     if (frames->fps_counter.started) {
         fps_counter_add_rendered_frame(&frames->fps_counter);
     }
@@ -97,6 +104,11 @@ const AVFrame *frames_consume_rendered_frame(struct frames *frames) {
     return frames->rendering_frame;
 }
 
+SDL_bool frames_is_rendering_frame_repeated(const struct frames *frames) {
+    return frames->has_consumed_frame
+        && frames->rendering_frame_checksum == frames->consumed_frame_checksum;
+}
+
 void frames_stop(struct frames *frames) {
 #ifdef SKIP_FRAMES
     (void) frames; // unused
@@ -19,6 +19,12 @@ struct frames {
     SDL_cond *rendering_frame_consumed_cond;
 #endif
     SDL_bool rendering_frame_consumed;
+    // checksums of the frames content, to detect frames which cannot change
+    // the picture (e.g. repeated by the encoder while the screen is idle)
+    Uint64 decoding_frame_checksum;
+    Uint64 rendering_frame_checksum;
+    Uint64 consumed_frame_checksum; // meaningful only if has_consumed_frame
+    SDL_bool has_consumed_frame;
     struct fps_counter fps_counter;
 };
 
@@ -36,6 +42,12 @@ SDL_bool frames_offer_decoded_frame(struct frames *frames);
 // unlocking frames->mutex
 const AVFrame *frames_consume_rendered_frame(struct frames *frames);
 
+// return true if the rendering frame has the same content as the last consumed
+// frame, so that rendering it again is useless
+// MUST be called with frames->mutex locked, before
+// frames_consume_rendered_frame()
+SDL_bool frames_is_rendering_frame_repeated(const struct frames *frames);
+
 // wake up and avoid any blocking call
 void frames_stop(struct frames *frames);
 
@@ -0,0 +1,167 @@
+#include "handshake.h"
+
+#include <string.h>
+
+#include "buffer_util.h"
+#include "log.h"
+
+// append an entry, return the number of bytes written
+static size_t write_entry(unsigned char *buf, Uint8 type, const void *value,
+                          Uint16 len) {
+    buf[0] = type;
+    buffer_write16be(&buf[1], len);
+    memcpy(&buf[HANDSHAKE_ENTRY_HEADER_LENGTH], value, len);
+    return HANDSHAKE_ENTRY_HEADER_LENGTH + len;
+}
+
+static size_t write_u8_entry(unsigned char *buf, Uint8 type, Uint8 value) {
+    return write_entry(buf, type, &value, 1);
+}
+
+static size_t write_u16_entry(unsigned char *buf, Uint8 type, Uint16 value) {
+    Uint8 value_buf[2];
+    buffer_write16be(value_buf, value);
+    return write_entry(buf, type, value_buf, 2);
+}
+
+static size_t write_u32_entry(unsigned char *buf, Uint8 type, Uint32 value) {
+    Uint8 value_buf[4];
+    buffer_write32be(value_buf, value);
+    return write_entry(buf, type, value_buf, 4);
+}
+
+size_t handshake_serialize_options(const struct handshake_options *options,
+                                   unsigned char *buf) {
+    size_t crop_len = options->crop ? strlen(options->crop) : 0;
+    // 6 fixed entries of at most 4 bytes, plus the crop entry
+    size_t max_len = HANDSHAKE_HEADER_LENGTH
+                   + 7 * HANDSHAKE_ENTRY_HEADER_LENGTH + 6 * 4 + crop_len;
+    if (max_len > HANDSHAKE_MAX_OPTIONS_LENGTH) {
+        LOGE("Handshake options too long");
+        return 0;
+    }
+
+    size_t len = HANDSHAKE_HEADER_LENGTH;
+    len += write_u16_entry(&buf[len], HANDSHAKE_OPTION_MAX_SIZE,
+                           options->max_size);
+    len += write_u32_entry(&buf[len], HANDSHAKE_OPTION_BIT_RATE,
+                           options->bit_rate);
+    if (options->crop) {
+        len += write_entry(&buf[len], HANDSHAKE_OPTION_CROP, options->crop,
+                           (Uint16) crop_len);
+    }
+    len += write_u8_entry(&buf[len], HANDSHAKE_OPTION_SEND_FRAME_META,
+                          options->send_frame_meta);
+    len += write_u8_entry(&buf[len], HANDSHAKE_OPTION_CONTROL_PROTOCOL_VERSION,
+                          options->control_protocol_version);
+    len += write_u8_entry(&buf[len], HANDSHAKE_OPTION_SQUARE_VIDEO,
+                          options->square_video);
+    len += write_u8_entry(&buf[len], HANDSHAKE_OPTION_CODEC,
+                          (Uint8) options->codec);
+
+    buf[0] = HANDSHAKE_VERSION;
+    buffer_write16be(&buf[1], (Uint16) (len - HANDSHAKE_HEADER_LENGTH));
+    return len;
+}
+
+SDL_bool handshake_parse_header(const unsigned char *buf,
+                                Uint16 *payload_length) {
+    // any version is accepted, a more recent version only adds entries
+    if (buf[0] < 1) {
+        LOGE("Invalid handshake version: %u", (unsigned) buf[0]);
+        return SDL_FALSE;
+    }
+    *payload_length = (buf[1] << 8) | buf[2];
+    if (*payload_length > HANDSHAKE_MAX_PAYLOAD_LENGTH) {
+        LOGE("Handshake payload too long: %u", (unsigned) *payload_length);
+        return SDL_FALSE;
+    }
+    return SDL_TRUE;
+}
+
+static SDL_bool parse_info_entry(Uint8 type, const unsigned char *value,
+                                 Uint16 len, struct device_info *info) {
+    switch (type) {
+        case HANDSHAKE_INFO_DEVICE_NAME: {
+            // truncate if necessary, the server is not trusted to respect the
+            // limit
+            size_t name_len = len < DEVICE_NAME_FIELD_LENGTH
+                            ? len : DEVICE_NAME_FIELD_LENGTH - 1;
+            memcpy(info->device_name, value, name_len);
+            info->device_name[name_len] = '\0';
+            return SDL_TRUE;
+        }
+        case HANDSHAKE_INFO_VIDEO_SIZE:
+            if (len != 4) {
+                break;
+            }
+            info->frame_size.width = (value[0] << 8) | value[1];
+            info->frame_size.height = (value[2] << 8) | value[3];
+            return SDL_TRUE;
+        case HANDSHAKE_INFO_CODEC:
+            if (len != 1) {
+                break;
+            }
+            if (value[0] != DEVICE_CODEC_H264 && value[0] != DEVICE_CODEC_H265) {
+                LOGE("Unknown video codec: %u", (unsigned) value[0]);
+                return SDL_FALSE;
+            }
+            info->codec = (enum device_codec) value[0];
+            return SDL_TRUE;
+        case HANDSHAKE_INFO_CONTROL_PROTOCOL_VERSION:
+            if (len != 1) {
+                break;
+            }
+            info->control_protocol_version = value[0];
+            return SDL_TRUE;
+        case HANDSHAKE_INFO_CAPABILITIES:
+            if (len != 4) {
+                break;
+            }
+            info->capabilities = buffer_read32be((Uint8 *) value);
+            return SDL_TRUE;
+        default:
+            // sent by a more recent server, ignore it
+            LOGD("Ignoring unknown handshake entry: %u", (unsigned) type);
+            return SDL_TRUE;
+    }
+    LOGE("Invalid length %u for handshake entry %u", (unsigned) len,
+         (unsigned) type);
+    return SDL_FALSE;
+}
+
+SDL_bool handshake_parse_device_info(const unsigned char *payload, size_t len,
+                                     struct device_info *info) {
+    // the defaults for the entries not sent by the server
+    info->device_name[0] = '\0';
+    info->frame_size.width = 0;
+    info->frame_size.height = 0;
+    info->codec = DEVICE_CODEC_H264;
+    info->control_protocol_version = 1;
+    info->capabilities = 0;
+
+    size_t i = 0;
+    while (i < len) {
+        if (len - i < HANDSHAKE_ENTRY_HEADER_LENGTH) {
+            LOGE("Truncated handshake entry");
+            return SDL_FALSE;
+        }
+        Uint8 type = payload[i];
+        Uint16 value_len = (payload[i + 1] << 8) | payload[i + 2];
+        i += HANDSHAKE_ENTRY_HEADER_LENGTH;
+        if (len - i < value_len) {
+            LOGE("Truncated handshake entry %u", (unsigned) type);
+            return SDL_FALSE;
+        }
+        if (!parse_info_entry(type, &payload[i], value_len, info)) {
+            return SDL_FALSE;
+        }
+        i += value_len;
+    }
+
+    if (!info->frame_size.width || !info->frame_size.height) {
+        LOGE("The device did not send the video size");
+        return SDL_FALSE;
+    }
+    return SDL_TRUE;
+}
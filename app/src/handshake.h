@@ -0,0 +1,81 @@
+#ifndef HANDSHAKE_H
+#define HANDSHAKE_H
+
+#include <stddef.h>
+#include <SDL2/SDL_stdinc.h>
+
+#include "common.h"
+#include "device.h"
+
+// The client and the server exchange a "hello" message once the sockets are
+// connected: the client sends its options on the control socket, the server
+// answers with the device info on the video socket.
+//
+// A hello message is:
+//  - a header: the handshake version (1 byte) and the payload length (2 bytes)
+//  - a payload: a sequence of TLV entries, each being a type (1 byte), a value
+//    length (2 bytes) and the value
+//
+// All integers are big-endian. Unknown entries are skipped, so that new
+// options and capabilities do not require to bump the version; absent entries
+// keep their default values.
+//
+// The server answers with the lowest of both versions. It still accepts the
+// former positional arguments, and then answers with the legacy fixed-size
+// device info, so that older clients keep working.
+#define HANDSHAKE_VERSION 1
+#define HANDSHAKE_HEADER_LENGTH 3
+#define HANDSHAKE_ENTRY_HEADER_LENGTH 3
+#define HANDSHAKE_MAX_PAYLOAD_LENGTH 1024
+
+// entries sent by the client
+enum handshake_option_type {
+    HANDSHAKE_OPTION_MAX_SIZE = 1, // u16
+    HANDSHAKE_OPTION_BIT_RATE = 2, // u32
+    HANDSHAKE_OPTION_CROP = 3, // string "width:height:x:y"
+    HANDSHAKE_OPTION_SEND_FRAME_META = 4, // u8 (boolean)
+    HANDSHAKE_OPTION_CONTROL_PROTOCOL_VERSION = 5, // u8
+    HANDSHAKE_OPTION_SQUARE_VIDEO = 6, // u8 (boolean)
+    HANDSHAKE_OPTION_CODEC = 7, // u8 (enum device_codec)
+};
+
+// entries sent by the server
+enum handshake_info_type {
+    HANDSHAKE_INFO_DEVICE_NAME = 1, // string
+    HANDSHAKE_INFO_VIDEO_SIZE = 2, // u16 width, u16 height
+    HANDSHAKE_INFO_CODEC = 3, // u8 (enum device_codec)
+    HANDSHAKE_INFO_CONTROL_PROTOCOL_VERSION = 4, // u8
+    HANDSHAKE_INFO_CAPABILITIES = 5, // u32 (HANDSHAKE_CAPABILITY_* flags)
+};
+
+#define HANDSHAKE_CAPABILITY_H265_ENCODER 1
+#define HANDSHAKE_CAPABILITY_REGION 2
+#define HANDSHAKE_CAPABILITY_PAUSE_VIDEO 4
+
+struct handshake_options {
+    Uint16 max_size;
+    Uint32 bit_rate;
+    const char *crop; // NULL for no crop
+    SDL_bool send_frame_meta;
+    Uint8 control_protocol_version;
+    SDL_bool square_video;
+    enum device_codec codec; // the preferred codec
+};
+
+#define HANDSHAKE_MAX_OPTIONS_LENGTH 256
+
+// buf must be at least HANDSHAKE_MAX_OPTIONS_LENGTH bytes
+// return the number of bytes written (header included), or 0 if the options
+// do not fit
+size_t handshake_serialize_options(const struct handshake_options *options,
+                                   unsigned char *buf);
+
+// read the header of a hello message (HANDSHAKE_HEADER_LENGTH bytes)
+SDL_bool handshake_parse_header(const unsigned char *buf,
+                                Uint16 *payload_length);
+
+// parse the payload of the server hello
+SDL_bool handshake_parse_device_info(const unsigned char *payload, size_t len,
+                                     struct device_info *info);
+
+#endif
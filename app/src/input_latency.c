@@ -0,0 +1,39 @@
+#include "input_latency.h"
+
+#include <inttypes.h>
+#include <SDL2/SDL_timer.h>
+
+#include "log.h"
+
+static void reset(struct input_latency *latency, Uint32 now) {
+    latency->slice_start = now;
+    latency->nr_events = 0;
+    latency->total = 0;
+    latency->max = 0;
+}
+
+void input_latency_init(struct input_latency *latency) {
+    reset(latency, SDL_GetTicks());
+}
+
+static void check_expired(struct input_latency *latency, Uint32 now) {
+    if (now - latency->slice_start >= 1000) {
+        if (latency->nr_events) {
+            LOGD("Input latency: %" PRIu32 " ms avg, %" PRIu32 " ms max "
+                 "(%d events)", latency->total / latency->nr_events,
+                 latency->max, latency->nr_events);
+        }
+        reset(latency, now);
+    }
+}
+
+void input_latency_add(struct input_latency *latency, Uint32 event_timestamp) {
+    Uint32 now = SDL_GetTicks();
+    check_expired(latency, now);
+    Uint32 delay = now - event_timestamp;
+    ++latency->nr_events;
+    latency->total += delay;
+    if (delay > latency->max) {
+        latency->max = delay;
+    }
+}
@@ -0,0 +1,22 @@
+#ifndef INPUTLATENCY_H
+#define INPUTLATENCY_H
+
+#include <SDL2/SDL_stdinc.h>
+
+// measure the delay between the time an input event is received by SDL and
+// the time it has been handled (i.e. pushed to the controller)
+struct input_latency {
+    Uint32 slice_start; // initialized by SDL_GetTicks()
+    int nr_events;
+    Uint32 total; // ms
+    Uint32 max; // ms
+};
+
+void input_latency_init(struct input_latency *latency);
+
+// record an input event handled now, whose timestamp (as provided by SDL) is
+// event_timestamp
+// the stats are logged (in debug) every second
+void input_latency_add(struct input_latency *latency, Uint32 event_timestamp);
+
+#endif
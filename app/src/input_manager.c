@@ -1,6 +1,9 @@
 #include "input_manager.h"
 
+#include <inttypes.h>
+#include <stdlib.h>
 #include <SDL2/SDL_assert.h>
+#include <SDL2/SDL_timer.h>
 #include "convert.h"
 #include "lock_util.h"
 #include "log.h"
@@ -94,6 +97,45 @@ static void press_back_or_turn_screen_on(struct controller *controller) {
     }
 }
 
+static void set_video_paused(struct input_manager *input_manager,
+                             SDL_bool paused) {
+    if (paused == input_manager->video_paused) {
+        return;
+    }
+    struct control_event control_event;
+    control_event.type = CONTROL_EVENT_TYPE_COMMAND;
+    control_event.command_event.action = paused
+                                       ? CONTROL_EVENT_COMMAND_PAUSE_VIDEO
+                                       : CONTROL_EVENT_COMMAND_RESUME_VIDEO;
+
+    if (!controller_push_event(input_manager->controller, &control_event)) {
+        LOGW("Cannot %s video", paused ? "pause" : "resume");
+        return;
+    }
+    input_manager->video_paused = paused;
+    LOGD("Video %s", paused ? "paused" : "resumed");
+}
+
+void input_manager_process_window_event(struct input_manager *input_manager,
+                                        const SDL_WindowEvent *event) {
+    if (!input_manager->pause_hidden_video) {
+        return;
+    }
+    switch (event->event) {
+        case SDL_WINDOWEVENT_MINIMIZED:
+        case SDL_WINDOWEVENT_HIDDEN:
+            // nobody watches, do not encode, transmit and decode for nothing
+            set_video_paused(input_manager, SDL_TRUE);
+            break;
+        case SDL_WINDOWEVENT_RESTORED:
+        case SDL_WINDOWEVENT_MAXIMIZED:
+        case SDL_WINDOWEVENT_SHOWN:
+        case SDL_WINDOWEVENT_EXPOSED:
+            set_video_paused(input_manager, SDL_FALSE);
+            break;
+    }
+}
+
 static void switch_fps_counter_state(struct frames *frames) {
     mutex_lock(frames->mutex);
     if (frames->fps_counter.started) {
@@ -106,6 +148,209 @@ static void switch_fps_counter_state(struct frames *frames) {
     mutex_unlock(frames->mutex);
 }
 
+#define VIDEO_BIT_RATE_MIN 250000
+#define VIDEO_BIT_RATE_MAX 100000000
+#define VIDEO_MAX_SIZE_MIN 240
+#define VIDEO_MAX_SIZE_MAX 0xfff8 // the greatest multiple of 8 in 16 bits
+#define VIDEO_FRAME_RATE_STEP 10
+#define VIDEO_FRAME_RATE_MIN 10
+// ignore the window size changes smaller than this ratio of the video size
+// (typically, the window is adjusted to the aspect ratio of the new video)
+#define VIDEO_FIT_THRESHOLD_PERCENT 10
+
+// a value of 0 keeps the current one
+static SDL_bool send_video_settings(struct controller *controller,
+                                    Uint32 bit_rate, Uint16 max_size,
+                                    Uint16 frame_rate) {
+    struct control_event control_event;
+    control_event.type = CONTROL_EVENT_TYPE_VIDEO;
+    control_event.video_event.bit_rate = bit_rate;
+    control_event.video_event.max_size = max_size;
+    control_event.video_event.frame_rate = frame_rate;
+
+    if (!controller_push_event(controller, &control_event)) {
+        LOGW("Cannot send video settings");
+        return SDL_FALSE;
+    }
+    return SDL_TRUE;
+}
+
+static void change_bit_rate(struct input_manager *input_manager,
+                            SDL_bool increase) {
+    Uint32 bit_rate = input_manager->bit_rate;
+    bit_rate = increase ? bit_rate * 2 : bit_rate / 2;
+    if (bit_rate < VIDEO_BIT_RATE_MIN) {
+        bit_rate = VIDEO_BIT_RATE_MIN;
+    } else if (bit_rate > VIDEO_BIT_RATE_MAX) {
+        bit_rate = VIDEO_BIT_RATE_MAX;
+    }
+    if (bit_rate == input_manager->bit_rate) {
+        return;
+    }
+    if (input_manager->abr) {
+        // the shortcuts change the upper bound of the adaptive bit-rate
+        LOGI("Video max bit-rate: %" PRIu32 " bps", bit_rate);
+        input_manager->bit_rate = bit_rate;
+        if (abr_set_max_bit_rate(input_manager->abr, bit_rate)) {
+            send_video_settings(input_manager->controller, bit_rate, 0, 0);
+        }
+        return;
+    }
+    if (send_video_settings(input_manager->controller, bit_rate, 0, 0)) {
+        LOGI("Video bit-rate: %" PRIu32 " bps", bit_rate);
+        input_manager->bit_rate = bit_rate;
+    }
+}
+
+void input_manager_update_bit_rate(struct input_manager *input_manager) {
+    if (!input_manager->abr) {
+        return;
+    }
+    Uint32 bit_rate;
+    if (abr_update(input_manager->abr, SDL_GetTicks(), &bit_rate)) {
+        // on failure, the encoder keeps its bit-rate until the next decision
+        send_video_settings(input_manager->controller, bit_rate, 0, 0);
+    }
+}
+
+// the lowest of the non-zero limits, 0 if unlimited
+static Uint16 get_effective_max_size(const struct input_manager *input_manager) {
+    Uint16 max_size = input_manager->max_size;
+    Uint16 window_max_size = input_manager->window_max_size;
+    if (!max_size || (window_max_size && window_max_size < max_size)) {
+        return window_max_size;
+    }
+    return max_size;
+}
+
+static void change_max_size(struct input_manager *input_manager,
+                            SDL_bool increase) {
+    int max_size = input_manager->max_size;
+    if (!max_size) {
+        // unlimited, start from the current video size
+        struct size frame_size = input_manager->screen->frame_size;
+        max_size = frame_size.width > frame_size.height ? frame_size.width
+                                                        : frame_size.height;
+    }
+    // 25% steps
+    max_size = increase ? max_size * 5 / 4 : max_size * 4 / 5;
+    max_size &= ~7; // multiple of 8
+    if (max_size < VIDEO_MAX_SIZE_MIN) {
+        max_size = VIDEO_MAX_SIZE_MIN;
+    } else if (max_size > VIDEO_MAX_SIZE_MAX) {
+        max_size = VIDEO_MAX_SIZE_MAX;
+    }
+    if (max_size == input_manager->max_size) {
+        return;
+    }
+    Uint16 previous = input_manager->max_size;
+    input_manager->max_size = (Uint16) max_size;
+    // the server never upscales, so a max size greater than the device size
+    // is the same as unlimited
+    Uint16 effective = get_effective_max_size(input_manager);
+    if (send_video_settings(input_manager->controller, 0, effective, 0)) {
+        LOGI("Video max size: %d", max_size);
+    } else {
+        input_manager->max_size = previous;
+    }
+}
+
+void input_manager_fit_video_to_window(struct input_manager *input_manager) {
+    int max_size = screen_get_displayed_max_size(input_manager->screen);
+    if (!max_size) {
+        return;
+    }
+    // round up, so that the video is never downscaled by the renderer
+    max_size = (max_size + 7) & ~7;
+    if (max_size < VIDEO_MAX_SIZE_MIN) {
+        max_size = VIDEO_MAX_SIZE_MIN;
+    } else if (max_size > VIDEO_MAX_SIZE_MAX) {
+        max_size = VIDEO_MAX_SIZE_MAX;
+    }
+    int previous = input_manager->window_max_size;
+    if (previous && abs(max_size - previous) * 100
+            < previous * VIDEO_FIT_THRESHOLD_PERCENT) {
+        return;
+    }
+    input_manager->window_max_size = (Uint16) max_size;
+    Uint16 effective = get_effective_max_size(input_manager);
+    if (send_video_settings(input_manager->controller, 0, effective, 0)) {
+        LOGD("Video max size fitting the window: %d", max_size);
+    } else {
+        input_manager->window_max_size = (Uint16) previous;
+    }
+}
+
+static void change_frame_rate(struct input_manager *input_manager,
+                              SDL_bool increase) {
+    int frame_rate = input_manager->frame_rate;
+    frame_rate += increase ? VIDEO_FRAME_RATE_STEP : -VIDEO_FRAME_RATE_STEP;
+    if (frame_rate < VIDEO_FRAME_RATE_MIN) {
+        frame_rate = VIDEO_FRAME_RATE_MIN;
+    } else if (frame_rate > VIDEO_DEFAULT_FRAME_RATE) {
+        frame_rate = VIDEO_DEFAULT_FRAME_RATE;
+    }
+    if (frame_rate == input_manager->frame_rate) {
+        return;
+    }
+    if (send_video_settings(input_manager->controller, 0, 0, frame_rate)) {
+        LOGI("Video frame rate: %d fps", frame_rate);
+        input_manager->frame_rate = (Uint16) frame_rate;
+    }
+}
+
+static void send_region(struct controller *controller, struct size frame_size,
+                        int x, int y, int width, int height) {
+    struct control_event control_event;
+    control_event.type = CONTROL_EVENT_TYPE_REGION;
+    control_event.region_event.position.screen_size = frame_size;
+    control_event.region_event.position.point.x = x;
+    control_event.region_event.position.point.y = y;
+    control_event.region_event.width = (Uint16) (width < 0xffff ? width : 0xffff);
+    control_event.region_event.height = (Uint16) (height < 0xffff ? height : 0xffff);
+    if (!controller_push_event(controller, &control_event)) {
+        LOGW("Cannot send region event");
+    }
+}
+
+// the device captures only the region which will be displayed, so the zoomed
+// video is encoded at full resolution (the server clips the region to the
+// video content, keeps its aspect ratio and keeps it inside the initial
+// content)
+static void zoom(struct input_manager *input_manager, SDL_bool in) {
+    struct size frame_size = input_manager->screen->frame_size;
+    if (!frame_size.width || !frame_size.height) {
+        return;
+    }
+    int width;
+    int height;
+    struct point center;
+    if (in) {
+        width = frame_size.width / 2;
+        height = frame_size.height / 2;
+        // zoom towards the mouse pointer, if it is over the video
+        center = get_mouse_point(input_manager->screen);
+        if (center.x < 0 || center.x >= frame_size.width
+                || center.y < 0 || center.y >= frame_size.height) {
+            center.x = frame_size.width / 2;
+            center.y = frame_size.height / 2;
+        }
+    } else {
+        width = frame_size.width * 2;
+        height = frame_size.height * 2;
+        center.x = frame_size.width / 2;
+        center.y = frame_size.height / 2;
+    }
+    send_region(input_manager->controller, frame_size,
+                center.x - width / 2, center.y - height / 2, width, height);
+}
+
+static void reset_zoom(struct input_manager *input_manager) {
+    // a size of 0 restores the initial crop
+    send_region(input_manager->controller, input_manager->screen->frame_size,
+                0, 0, 0, 0);
+}
+
 static void clipboard_paste(struct controller *controller) {
     char *text = SDL_GetClipboardText();
     if (!text) {
@@ -248,6 +493,36 @@ void input_manager_process_key(struct input_manager *input_manager,
                     switch_fps_counter_state(input_manager->frames);
                 }
                 return;
+            case SDLK_PAGEUP: // fall-through
+            case SDLK_PAGEDOWN:
+                if (ctrl && !meta && !repeat && event->type == SDL_KEYDOWN) {
+                    change_bit_rate(input_manager, keycode == SDLK_PAGEUP);
+                }
+                return;
+            case SDLK_RIGHTBRACKET: // fall-through
+            case SDLK_LEFTBRACKET:
+                if (ctrl && !meta && !repeat && event->type == SDL_KEYDOWN) {
+                    change_max_size(input_manager,
+                                    keycode == SDLK_RIGHTBRACKET);
+                }
+                return;
+            case SDLK_PERIOD: // fall-through
+            case SDLK_COMMA:
+                if (ctrl && !meta && !repeat && event->type == SDL_KEYDOWN) {
+                    change_frame_rate(input_manager, keycode == SDLK_PERIOD);
+                }
+                return;
+            case SDLK_EQUALS: // fall-through
+            case SDLK_MINUS:
+                if (ctrl && !meta && !repeat && event->type == SDL_KEYDOWN) {
+                    zoom(input_manager, keycode == SDLK_EQUALS);
+                }
+                return;
+            case SDLK_0:
+                if (ctrl && !meta && !repeat && event->type == SDL_KEYDOWN) {
+                    reset_zoom(input_manager);
+                }
+                return;
         }
 
         return;
@@ -298,7 +573,10 @@ void input_manager_process_mouse_motion(struct input_manager *input_manager,
     SDL_Point mousepos = {event->x, event->y};
     SDL_bool device_event=SDL_TRUE;
 
-    int toolbarqty = sizeof(input_manager->screen->toolbar) / sizeof(struct toolbar);
+    // when the toolbar is hidden, every event is for the device
+    int toolbarqty = input_manager->screen->toolbar_shown
+                     ? sizeof(input_manager->screen->toolbar) / sizeof(struct toolbar)
+                     : 0;
     for (int i=0;i<toolbarqty;i++){
         //Mouseover = FALSE on all the buttons for all the toolbars
         int nbuttons=sizeof(input_manager->screen->toolbar[i].buttons) / sizeof(struct button);
@@ -387,7 +665,9 @@ void input_manager_process_mouse_button(struct input_manager *input_manager,
 
     SDL_bool device_event=SDL_TRUE;
 
-    int toolbarqty = sizeof(input_manager->screen->toolbar) / sizeof(struct toolbar);
+    int toolbarqty = input_manager->screen->toolbar_shown
+                     ? sizeof(input_manager->screen->toolbar) / sizeof(struct toolbar)
+                     : 0;
     for (int i=toolbarqty-1;i>=0;i--){
         int toolbarindex = input_manager->screen->toolbar_zindex_sort_down_to_top[i];
         if (SDL_PointInRect(&mousepos, &input_manager->screen->toolbar[toolbarindex].rect)){
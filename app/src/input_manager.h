@@ -1,16 +1,31 @@
 #ifndef INPUTMANAGER_H
 #define INPUTMANAGER_H
 
+#include "abr.h"
 #include "common.h"
 #include "controller.h"
 #include "fps_counter.h"
 #include "frames.h"
 #include "screen.h"
 
+// the frame rate of the server encoder if not changed
+#define VIDEO_DEFAULT_FRAME_RATE 60
+
 struct input_manager {
     struct controller *controller;
     struct frames *frames;
     struct screen *screen;
+    // current encoder settings, changed by shortcuts
+    Uint32 bit_rate; // the max bit-rate if the bit-rate is adaptive
+    Uint16 max_size; // 0 if unlimited
+    // the max size fitting the window, 0 if the video does not follow the
+    // window size (the encoder uses the lowest of both limits)
+    Uint16 window_max_size;
+    Uint16 frame_rate;
+    struct abr *abr; // NULL if the bit-rate is not adaptive
+    // pause the video while the window is minimized (not if recording)
+    SDL_bool pause_hidden_video;
+    SDL_bool video_paused;
 };
 
 void input_manager_process_text_input(struct input_manager *input_manager,
@@ -26,6 +41,17 @@ void input_manager_process_mouse_button(struct input_manager *input_manager,
 void input_manager_process_mouse_wheel(struct input_manager *input_manager,
                                        const SDL_MouseWheelEvent *event);
 
+// send the bit-rate decided by the adaptive bit-rate controller, if any
+void input_manager_update_bit_rate(struct input_manager *input_manager);
+
+// to be called on window events, to pause the video while the window is
+// minimized or hidden
+void input_manager_process_window_event(struct input_manager *input_manager,
+                                        const SDL_WindowEvent *event);
+
+// request a video size matching the size displayed in the window
+void input_manager_fit_video_to_window(struct input_manager *input_manager);
+
 void action_home(struct controller *controller, int actions);
 void action_back(struct controller *controller, int actions);
 void action_app_switch(struct controller *controller, int actions);
@@ -24,6 +24,10 @@ struct args {
     Uint16 max_size;
     Uint32 bit_rate;
     SDL_bool always_on_top;
+    SDL_bool square_video;
+    SDL_bool adaptive_bit_rate;
+    SDL_bool fit_video_to_window;
+    enum device_codec codec;
 };
 
 static void usage(const char *arg0) {
@@ -32,11 +36,20 @@ static void usage(const char *arg0) {
         "\n"
         "Options:\n"
         "\n"
+        "    -A, --adaptive-bit-rate\n"
+        "        Adapt the video bit-rate to the network, so that the latency\n"
+        "        stays low. The --bit-rate value is the maximum.\n"
+        "\n"
         "    -b, --bit-rate value\n"
         "        Encode the video at the given bit-rate, expressed in bits/s.\n"
         "        Unit suffixes are supported: 'K' (x1000) and 'M' (x1000000).\n"
         "        Default is %d.\n"
         "\n"
+        "    -C, --codec name\n"
+        "        Encode the video with the given codec: h264 or h265.\n"
+        "        If the device has no encoder for it, h264 is used.\n"
+        "        Default is h264.\n"
+        "\n"
         "    -c, --crop width:height:x:y\n"
         "        Crop the device screen on the server.\n"
         "        The values are expressed in the device natural orientation\n"
@@ -46,6 +59,11 @@ static void usage(const char *arg0) {
         "    -f, --fullscreen\n"
         "        Start in fullscreen.\n"
         "\n"
+        "    -F, --fit-video-to-window\n"
+        "        Adapt the video size to the window size, so that a small\n"
+        "        window does not receive a full resolution video. The\n"
+        "        --max-size value is still the upper bound.\n"
+        "\n"
         "    -n, --onscreen_menus_off\n"
         "        Hide onscreen menus.\n"
         "\n"
@@ -69,6 +87,11 @@ static void usage(const char *arg0) {
         "        The format is determined by the file extension (.mp4 or .mkv).\n"
         "        If ivalid file extension specified by default will be MP4."
         "\n"
+        "    -S, --square-video\n"
+        "        Letterbox the device screen into a square video, so that the\n"
+        "        device rotation does not restart the encoder (and does not\n"
+        "        resize the window).\n"
+        "\n"
         "    -s, --serial\n"
         "        The device serial number. Mandatory only if several devices\n"
         "        are connected to adb.\n"
@@ -132,6 +155,26 @@ static void usage(const char *arg0) {
         "    Ctrl+i\n"
         "        enable/disable FPS counter (print frames/second in logs)\n"
         "\n"
+        "    Ctrl+PageUp\n"
+        "    Ctrl+PageDown\n"
+        "        double/halve the video bit-rate\n"
+        "\n"
+        "    Ctrl+]\n"
+        "    Ctrl+[\n"
+        "        increase/decrease the video max size\n"
+        "\n"
+        "    Ctrl+.\n"
+        "    Ctrl+,\n"
+        "        increase/decrease the video frame rate\n"
+        "\n"
+        "    Ctrl+=\n"
+        "    Ctrl+-\n"
+        "        zoom in (towards the mouse pointer)/out, the device encodes\n"
+        "        only the visible region\n"
+        "\n"
+        "    Ctrl+0\n"
+        "        reset the zoom\n"
+        "\n"
         "    Drag & drop APK file\n"
         "        install APK from computer\n"
         "\n",
@@ -203,6 +246,14 @@ static SDL_bool parse_max_size(char *optarg, Uint16 *max_size) {
     return SDL_TRUE;
 }
 
+static SDL_bool parse_codec(const char *optarg, enum device_codec *codec) {
+    if (!device_codec_from_name(optarg, codec)) {
+        LOGE("Unsupported codec: %s (expected h264 or h265)", optarg);
+        return SDL_FALSE;
+    }
+    return SDL_TRUE;
+}
+
 static SDL_bool parse_port(char *optarg, Uint16 *port) {
     char *endptr;
     if (*optarg == '\0') {
@@ -244,34 +295,49 @@ guess_record_format(const char *filename) {
 
 static SDL_bool parse_args(struct args *args, int argc, char *argv[]) {
     static const struct option long_options[] = {
+        {"adaptive-bit-rate",  no_argument,       NULL, 'A'},
         {"bit-rate",           required_argument, NULL, 'b'},
+        {"codec",              required_argument, NULL, 'C'},
         {"crop",               required_argument, NULL, 'c'},
         {"fullscreen",         no_argument,       NULL, 'f'},
+        {"fit-video-to-window", no_argument,      NULL, 'F'},
         {"onscreen_menus_off", no_argument,       NULL, 'n'},
         {"help",               no_argument,       NULL, 'h'},
         {"max-size",           required_argument, NULL, 'm'},
         {"port",               required_argument, NULL, 'p'},
         {"record",             required_argument, NULL, 'r'},
         {"serial",             required_argument, NULL, 's'},
+        {"square-video",       no_argument,       NULL, 'S'},
         {"show-touches",       no_argument,       NULL, 't'},
         {"always-on-top",      no_argument,       NULL, 'T'},
         {"version",            no_argument,       NULL, 'v'},
         {NULL,                 0,                 NULL, 0  },
     };
     int c;
-    while ((c = getopt_long(argc, argv, "b:c:fnhm:p:r:s:tTv", long_options, NULL)) != -1) {
+    while ((c = getopt_long(argc, argv, "Ab:C:c:fFnhm:p:r:s:StTv", long_options, NULL)) != -1) {
         switch (c) {
+            case 'A':
+                args->adaptive_bit_rate = SDL_TRUE;
+                break;
             case 'b':
                 if (!parse_bit_rate(optarg, &args->bit_rate)) {
                     return SDL_FALSE;
                 }
                 break;
+            case 'C':
+                if (!parse_codec(optarg, &args->codec)) {
+                    return SDL_FALSE;
+                }
+                break;
             case 'c':
                 args->crop = optarg;
                 break;
             case 'f':
                 args->fullscreen = SDL_TRUE;
                 break;
+            case 'F':
+                args->fit_video_to_window = SDL_TRUE;
+                break;
             case 'n':
                 args->onscreen_menus = SDL_FALSE;
                 break;
@@ -294,6 +360,9 @@ static SDL_bool parse_args(struct args *args, int argc, char *argv[]) {
             case 's':
                 args->serial = optarg;
                 break;
+            case 'S':
+                args->square_video = SDL_TRUE;
+                break;
             case 't':
                 args->show_touches = SDL_TRUE;
                 break;
@@ -334,6 +403,10 @@ int main(int argc, char *argv[]) {
         .version = SDL_FALSE,
         .show_touches = SDL_FALSE,
         .always_on_top = SDL_FALSE,
+        .square_video = SDL_FALSE,
+        .adaptive_bit_rate = SDL_FALSE,
+        .fit_video_to_window = SDL_FALSE,
+        .codec = DEVICE_CODEC_H264,
         .port = DEFAULT_LOCAL_PORT,
         .max_size = DEFAULT_MAX_SIZE,
         .bit_rate = DEFAULT_BIT_RATE,
@@ -375,7 +448,11 @@ int main(int argc, char *argv[]) {
         .show_touches = args.show_touches,
         .always_on_top = args.always_on_top,
         .fullscreen = args.fullscreen,
-        .onscreen_menus = args.onscreen_menus
+        .onscreen_menus = args.onscreen_menus,
+        .square_video = args.square_video,
+        .adaptive_bit_rate = args.adaptive_bit_rate,
+        .fit_video_to_window = args.fit_video_to_window,
+        .codec = args.codec,
     };
     int res = miralldroid(&options) ? 0 : 1;
 
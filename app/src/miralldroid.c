@@ -1,5 +1,6 @@
 #include "miralldroid.h"
 
+#include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
@@ -7,6 +8,7 @@
 #include <sys/time.h>
 #include <SDL2/SDL.h>
 
+#include "abr.h"
 #include "command.h"
 #include "common.h"
 #include "controller.h"
@@ -15,7 +17,9 @@
 #include "events.h"
 #include "file_handler.h"
 #include "frames.h"
+#include "handshake.h"
 #include "fps_counter.h"
+#include "input_latency.h"
 #include "input_manager.h"
 #include "log.h"
 #include "lock_util.h"
@@ -32,6 +36,8 @@ static struct decoder decoder;
 static struct controller controller;
 static struct file_handler file_handler;
 static struct recorder recorder;
+static struct input_latency input_latency;
+static struct abr abr;
 
 static struct input_manager input_manager = {
     .controller = &controller,
@@ -63,66 +69,131 @@ static SDL_bool is_apk(const char *file) {
     return ext && !strcmp(ext, ".apk");
 }
 
+enum event_result {
+    EVENT_RESULT_CONTINUE,
+    EVENT_RESULT_STOPPED_BY_USER,
+    EVENT_RESULT_STOPPED_BY_EOS,
+    EVENT_RESULT_ERROR,
+};
+
+static SDL_bool is_input_event(const SDL_Event *event) {
+    switch (event->type) {
+        case SDL_TEXTINPUT:
+        case SDL_KEYDOWN:
+        case SDL_KEYUP:
+        case SDL_MOUSEMOTION:
+        case SDL_MOUSEWHEEL:
+        case SDL_MOUSEBUTTONDOWN:
+        case SDL_MOUSEBUTTONUP:
+            return SDL_TRUE;
+    }
+    return SDL_FALSE;
+}
+
+// render is set to true if the event requires to render the screen
+static enum event_result handle_event(SDL_Event *event, SDL_bool *render) {
+    switch (event->type) {
+        case EVENT_DECODER_STOPPED:
+            LOGD("Video decoder stopped");
+            return EVENT_RESULT_STOPPED_BY_EOS;
+        case SDL_QUIT:
+            LOGD("User requested to quit");
+            return EVENT_RESULT_STOPPED_BY_USER;
+        case EVENT_NEW_FRAME:
+            if (!screen.has_frame) {
+                screen.has_frame = SDL_TRUE;
+                // this is the very first frame, show the window
+                screen_show_window(&screen);
+                if (screen.fit_video_to_window) {
+                    // the initial window may be smaller than the video
+                    screen_schedule_video_size_request(&screen);
+                }
+            }
+            SDL_bool repeated;
+            if (!screen_update_frame(&screen, &frames, &repeated)) {
+                return EVENT_RESULT_ERROR;
+            }
+            // the frames are the clock of the adaptive bit-rate decisions
+            input_manager_update_bit_rate(&input_manager);
+            if (repeated) {
+                // the picture did not change, do not render it again
+                return EVENT_RESULT_CONTINUE;
+            }
+            break;
+        case EVENT_VIDEO_SIZE_REQUEST:
+            input_manager_fit_video_to_window(&input_manager);
+            return EVENT_RESULT_CONTINUE;
+        case SDL_TEXTINPUT:
+            input_manager_process_text_input(&input_manager, &event->text);
+            break;
+        case SDL_KEYDOWN:
+        case SDL_KEYUP:
+            input_manager_process_key(&input_manager, &event->key);
+            break;
+        case SDL_MOUSEMOTION:
+            input_manager_process_mouse_motion(&input_manager, &event->motion);
+            break;
+        case SDL_MOUSEWHEEL:
+            input_manager_process_mouse_wheel(&input_manager, &event->wheel);
+            break;
+        case SDL_MOUSEBUTTONDOWN:
+        case SDL_MOUSEBUTTONUP:
+            input_manager_process_mouse_button(&input_manager, &event->button);
+            break;
+        case SDL_DROPFILE: {
+            file_handler_action_t action;
+            if (is_apk(event->drop.file)) {
+                action = ACTION_INSTALL_APK;
+            } else {
+                action = ACTION_PUSH_FILE;
+            }
+            file_handler_request(&file_handler, action, event->drop.file);
+            break;
+        }
+        case SDL_WINDOWEVENT: {
+            screen_handle_window_event(&screen, &event->window);
+            input_manager_process_window_event(&input_manager, &event->window);
+            switch (event->window.event) {
+                case  SDL_WINDOWEVENT_LEAVE:
+                  input_manager_process_mouse_leavewindow(&input_manager, &event->motion);
+                  break;
+            }
+            break;
+        }
+    }
+    if (is_input_event(event)) {
+        input_latency_add(&input_latency, event->common.timestamp);
+    }
+    *render = SDL_TRUE;
+    return EVENT_RESULT_CONTINUE;
+}
+
 static SDL_bool event_loop(void) {
 #ifdef CONTINUOUS_RESIZING_WORKAROUND
     SDL_AddEventWatch(event_watcher, NULL);
 #endif
+    input_latency_init(&input_latency);
     SDL_Event event;
     while (SDL_WaitEvent(&event)) {
-        switch (event.type) {
-            case EVENT_DECODER_STOPPED:
-                LOGD("Video decoder stopped");
-                return SDL_FALSE;
-            case SDL_QUIT:
-                LOGD("User requested to quit");
-                return SDL_TRUE;
-            case EVENT_NEW_FRAME:
-                if (!screen.has_frame) {
-                    screen.has_frame = SDL_TRUE;
-                    // this is the very first frame, show the window
-                    screen_show_window(&screen);
-                }
-                if (!screen_update_frame(&screen, &frames)) {
+        SDL_bool render = SDL_FALSE;
+        // Handle all the pending events before rendering: SDL_RenderPresent()
+        // may block (until vsync), so rendering after each event would delay
+        // the next input events. This way, input events are forwarded to the
+        // controller as soon as possible, and the screen is rendered once.
+        do {
+            enum event_result result = handle_event(&event, &render);
+            switch (result) {
+                case EVENT_RESULT_STOPPED_BY_USER:
+                    return SDL_TRUE;
+                case EVENT_RESULT_STOPPED_BY_EOS:
+                case EVENT_RESULT_ERROR:
                     return SDL_FALSE;
-                }
-                break;
-            case SDL_TEXTINPUT:
-                input_manager_process_text_input(&input_manager, &event.text);
-                break;
-            case SDL_KEYDOWN:
-            case SDL_KEYUP:
-                input_manager_process_key(&input_manager, &event.key);
-                break;
-            case SDL_MOUSEMOTION:
-                input_manager_process_mouse_motion(&input_manager, &event.motion);
-                break;
-            case SDL_MOUSEWHEEL:
-                input_manager_process_mouse_wheel(&input_manager, &event.wheel);
-                break;
-            case SDL_MOUSEBUTTONDOWN:
-            case SDL_MOUSEBUTTONUP:
-                input_manager_process_mouse_button(&input_manager, &event.button);
-                break;
-            case SDL_DROPFILE: {
-                file_handler_action_t action;
-                if (is_apk(event.drop.file)) {
-                    action = ACTION_INSTALL_APK;
-                } else {
-                    action = ACTION_PUSH_FILE;
-                }
-                file_handler_request(&file_handler, action, event.drop.file);
-                break;
+                case EVENT_RESULT_CONTINUE:
+                    break;
             }
-            case SDL_WINDOWEVENT: {
-                switch (event.window.event) {
-                    case  SDL_WINDOWEVENT_LEAVE:
-                      input_manager_process_mouse_leavewindow(&input_manager, &event.motion);
-                      break;
-                }
-                break;
-            }
-        }
-        if (screen.has_frame) {
+        } while (SDL_PollEvent(&event));
+
+        if (render && screen.has_frame) {
             screen_render(&screen);
         }
     }
@@ -176,11 +247,83 @@ av_log_callback(void *avcl, int level, const char *fmt, va_list vl) {
     SDL_free(local_fmt);
 }
 
+struct server_bootstrap {
+    const struct miralldroid_options *options;
+    SDL_bool started; // the server process has been executed
+    SDL_bool connected; // the connection is established and the info is read
+    struct device_info info;
+};
+
+// start the server and read the device info, executed in a separate thread so
+// that the UI is initialized in parallel
+static int run_server_bootstrap(void *data) {
+    struct server_bootstrap *bootstrap = data;
+    const struct miralldroid_options *options = bootstrap->options;
+
+    if (!server_start(&server, options->serial, options->port)) {
+        return 0;
+    }
+    bootstrap->started = SDL_TRUE;
+
+    if (!server_connect_to(&server)) {
+        return 0;
+    }
+
+    struct handshake_options handshake_options = {
+        .max_size = options->max_size,
+        .bit_rate = options->bit_rate,
+        .crop = options->crop,
+        // the adaptive bit-rate measures the delays from the PTS
+        .send_frame_meta = options->record_filename
+                        || options->adaptive_bit_rate,
+        .control_protocol_version = CONTROL_PROTOCOL_VERSION,
+        .square_video = options->square_video,
+        .codec = options->codec,
+    };
+    if (!device_send_options(server.control_socket, &handshake_options)) {
+        return 0;
+    }
+
+    // screenrecord does not send frames when the screen content does not change
+    // therefore, we transmit the screen size before the video stream, to be able
+    // to init the window immediately
+    if (!device_read_info(server.video_socket, &bootstrap->info)) {
+        return 0;
+    }
+
+    bootstrap->connected = SDL_TRUE;
+    return 0;
+}
+
 SDL_bool miralldroid(const struct miralldroid_options *options) {
-    SDL_bool send_frame_meta = !!options->record_filename;
-    if (!server_start(&server, options->serial, options->port,
-                      options->max_size, options->bit_rate, options->crop,
-                      send_frame_meta)) {
+    if (!sdl_init_and_configure()) {
+        return SDL_FALSE;
+    }
+
+    struct server_bootstrap bootstrap = {
+        .options = options,
+        .started = SDL_FALSE,
+        .connected = SDL_FALSE,
+    };
+    SDL_Thread *bootstrap_thread = SDL_CreateThread(run_server_bootstrap,
+                                                    "server_bootstrap",
+                                                    &bootstrap);
+    if (!bootstrap_thread) {
+        LOGC("Could not start server bootstrap thread");
+        return SDL_FALSE;
+    }
+
+    // the window, renderer and font do not depend on the device: initialize
+    // them while the server is pushed, executed and connected
+    SDL_bool rendering_initialized =
+            screen_init_rendering(&screen, options->always_on_top);
+
+    SDL_WaitThread(bootstrap_thread, NULL);
+
+    if (!bootstrap.started) {
+        if (rendering_initialized) {
+            screen_destroy(&screen);
+        }
         return SDL_FALSE;
     }
 
@@ -194,34 +337,37 @@ SDL_bool miralldroid(const struct miralldroid_options *options) {
 
     SDL_bool ret = SDL_TRUE;
 
-    if (!sdl_init_and_configure()) {
+    if (!rendering_initialized) {
+        server_stop(&server);
         ret = SDL_FALSE;
         goto finally_destroy_server;
     }
 
-    socket_t device_socket = server_connect_to(&server);
-    if (device_socket == INVALID_SOCKET) {
+    if (!bootstrap.connected) {
         server_stop(&server);
         ret = SDL_FALSE;
-        goto finally_destroy_server;
+        goto finally_destroy_screen;
     }
 
-    char device_name[DEVICE_NAME_FIELD_LENGTH];
-    struct size frame_size;
+    const struct device_info *info = &bootstrap.info;
+    LOGD("Device capabilities: 0x%" PRIx32, info->capabilities);
+    struct size frame_size = info->frame_size;
+    if (info->codec != options->codec) {
+        LOGW("The device does not support %s, fallback to %s",
+             device_codec_name(options->codec),
+             device_codec_name(info->codec));
+    }
 
-    // screenrecord does not send frames when the screen content does not change
-    // therefore, we transmit the screen size before the video stream, to be able
-    // to init the window immediately
-    if (!device_read_info(device_socket, device_name, &frame_size)) {
+    if (!screen_init_frame(&screen, info->device_name, frame_size)) {
         server_stop(&server);
         ret = SDL_FALSE;
-        goto finally_destroy_server;
+        goto finally_destroy_screen;
     }
 
     if (!frames_init(&frames)) {
         server_stop(&server);
         ret = SDL_FALSE;
-        goto finally_destroy_server;
+        goto finally_destroy_screen;
     }
 
     if (!file_handler_init(&file_handler, server.serial)) {
@@ -230,6 +376,7 @@ SDL_bool miralldroid(const struct miralldroid_options *options) {
         goto finally_destroy_frames;
     }
 
+    struct abr *adaptive = NULL;
     struct recorder *rec = NULL;
     if (options->record_filename) {
         if (!recorder_init(&recorder,
@@ -245,17 +392,32 @@ SDL_bool miralldroid(const struct miralldroid_options *options) {
 
     av_log_set_callback(av_log_callback);
 
-    decoder_init(&decoder, &frames, device_socket, rec);
+    if (options->adaptive_bit_rate) {
+        if (!abr_init(&abr, options->bit_rate, ABR_DEFAULT_TARGET_DELAY_MS)) {
+            ret = SDL_FALSE;
+            server_stop(&server);
+            goto finally_destroy_recorder;
+        }
+        adaptive = &abr;
+    }
+    input_manager.abr = adaptive;
+
+    enum AVCodecID codec_id = info->codec == DEVICE_CODEC_H265
+                            ? AV_CODEC_ID_HEVC : AV_CODEC_ID_H264;
+    decoder_init(&decoder, &frames, server.video_socket, codec_id, rec,
+                 adaptive);
 
     // now we consumed the header values, the socket receives the video stream
     // start the decoder
     if (!decoder_start(&decoder)) {
         ret = SDL_FALSE;
         server_stop(&server);
-        goto finally_destroy_recorder;
+        goto finally_destroy_abr;
     }
 
-    if (!controller_init(&controller, device_socket)) {
+    // the server may not support the version requested
+    if (!controller_init(&controller, server.control_socket,
+                         info->control_protocol_version)) {
         ret = SDL_FALSE;
         goto finally_stop_decoder;
     }
@@ -265,11 +427,6 @@ SDL_bool miralldroid(const struct miralldroid_options *options) {
         goto finally_destroy_controller;
     }
 
-    if (!screen_init_rendering(&screen, device_name, frame_size, options->always_on_top)) {
-        ret = SDL_FALSE;
-        goto finally_stop_and_join_controller;
-    }
-
     if (options->show_touches) {
         wait_show_touches(proc_show_touches);
         show_touches_waited = SDL_TRUE;
@@ -279,16 +436,22 @@ SDL_bool miralldroid(const struct miralldroid_options *options) {
         screen_switch_fullscreen(&screen);
     }
 
-    if (!options->onscreen_menus) {
+    if (options->onscreen_menus) {
+        // load and show the toolbar
         toolbar_toggle(&screen);
     }
 
+    input_manager.bit_rate = options->bit_rate;
+    input_manager.max_size = options->max_size;
+    input_manager.frame_rate = VIDEO_DEFAULT_FRAME_RATE;
+    screen.fit_video_to_window = options->fit_video_to_window;
+    // the recording must not miss the frames while the window is minimized
+    input_manager.pause_hidden_video = !options->record_filename
+        && (info->capabilities & HANDSHAKE_CAPABILITY_PAUSE_VIDEO);
+
     ret = event_loop();
     LOGD("quit...");
 
-    screen_destroy(&screen);
-
-finally_stop_and_join_controller:
     controller_stop(&controller);
     controller_join(&controller);
 finally_destroy_controller:
@@ -302,12 +465,18 @@ finally_destroy_file_handler:
     file_handler_stop(&file_handler);
     file_handler_join(&file_handler);
     file_handler_destroy(&file_handler);
+finally_destroy_abr:
+    if (adaptive) {
+        abr_destroy(adaptive);
+    }
 finally_destroy_recorder:
     if (options->record_filename) {
         recorder_destroy(&recorder);
     }
 finally_destroy_frames:
     frames_destroy(&frames);
+finally_destroy_screen:
+    screen_destroy(&screen);
 finally_destroy_server:
     if (options->show_touches) {
         if (!show_touches_waited) {
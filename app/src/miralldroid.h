@@ -4,6 +4,8 @@
 #include <SDL2/SDL_stdinc.h>
 #include <recorder.h>
 
+#include "device.h"
+
 struct miralldroid_options {
     const char *serial;
     const char *crop;
@@ -16,6 +18,10 @@ struct miralldroid_options {
     SDL_bool always_on_top;
     SDL_bool fullscreen;
     SDL_bool onscreen_menus;
+    SDL_bool square_video;
+    SDL_bool adaptive_bit_rate;
+    SDL_bool fit_video_to_window;
+    enum device_codec codec; // requested, the server may fallback to H.264
 };
 
 SDL_bool miralldroid(const struct miralldroid_options *options);
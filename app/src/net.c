@@ -10,6 +10,7 @@
 # include <sys/types.h>
 # include <sys/socket.h>
 # include <netinet/in.h>
+# include <netinet/tcp.h>
 # include <arpa/inet.h>
 # include <unistd.h>
 # define SOCKET_ERROR -1
@@ -18,13 +19,31 @@
   typedef struct in_addr IN_ADDR;
 #endif
 
-socket_t net_connect(Uint32 addr, Uint16 port) {
+// failures are not fatal, the defaults just work less well
+static void set_buffer_sizes(socket_t sock, int send_buffer_size,
+                             int recv_buffer_size) {
+    if (send_buffer_size && setsockopt(sock, SOL_SOCKET, SO_SNDBUF,
+                                       (const void *) &send_buffer_size,
+                                       sizeof(send_buffer_size)) == -1) {
+        perror("setsockopt(SO_SNDBUF)");
+    }
+    if (recv_buffer_size && setsockopt(sock, SOL_SOCKET, SO_RCVBUF,
+                                       (const void *) &recv_buffer_size,
+                                       sizeof(recv_buffer_size)) == -1) {
+        perror("setsockopt(SO_RCVBUF)");
+    }
+}
+
+socket_t net_connect(Uint32 addr, Uint16 port, int send_buffer_size,
+                     int recv_buffer_size) {
     socket_t sock = socket(AF_INET, SOCK_STREAM, 0);
     if (sock == INVALID_SOCKET) {
         perror("socket");
         return INVALID_SOCKET;
     }
 
+    set_buffer_sizes(sock, send_buffer_size, recv_buffer_size);
+
     SOCKADDR_IN sin;
     sin.sin_family = AF_INET;
     sin.sin_addr.s_addr = htonl(addr);
@@ -38,7 +57,8 @@ socket_t net_connect(Uint32 addr, Uint16 port) {
     return sock;
 }
 
-socket_t net_listen(Uint32 addr, Uint16 port, int backlog) {
+socket_t net_listen(Uint32 addr, Uint16 port, int backlog,
+                    int send_buffer_size, int recv_buffer_size) {
     socket_t sock = socket(AF_INET, SOCK_STREAM, 0);
     if (sock == INVALID_SOCKET) {
         perror("socket");
@@ -50,6 +70,8 @@ socket_t net_listen(Uint32 addr, Uint16 port, int backlog) {
         perror("setsockopt(SO_REUSEADDR)");
     }
 
+    set_buffer_sizes(sock, send_buffer_size, recv_buffer_size);
+
     SOCKADDR_IN sin;
     sin.sin_family = AF_INET;
     sin.sin_addr.s_addr = htonl(addr); // htonl() harmless on INADDR_ANY
@@ -87,16 +109,25 @@ ssize_t net_send(socket_t socket, const void *buf, size_t len) {
 }
 
 ssize_t net_send_all(socket_t socket, const void *buf, size_t len) {
-    ssize_t w = 0;
+    size_t total = len;
     while (len > 0) {
-        w = send(socket, buf, len, 0);
+        ssize_t w = send(socket, buf, len, 0);
         if (w == -1) {
             return -1;
         }
         len -= w;
         buf = (char *) buf + w;
     }
-    return w;
+    return total;
+}
+
+SDL_bool net_set_nodelay(socket_t socket) {
+    int nodelay = 1;
+    if (setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, (const void *) &nodelay, sizeof(nodelay)) == -1) {
+        perror("setsockopt(TCP_NODELAY)");
+        return SDL_FALSE;
+    }
+    return SDL_TRUE;
 }
 
 SDL_bool net_shutdown(socket_t socket, int how) {
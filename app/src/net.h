@@ -19,8 +19,13 @@
 SDL_bool net_init(void);
 void net_cleanup(void);
 
-socket_t net_connect(Uint32 addr, Uint16 port);
-socket_t net_listen(Uint32 addr, Uint16 port, int backlog);
+// the buffer sizes (0 to keep the system default) are set before the
+// connection is established, since the receive buffer size determines the TCP
+// window scale; the accepted sockets inherit the sizes of the listening socket
+socket_t net_connect(Uint32 addr, Uint16 port, int send_buffer_size,
+                     int recv_buffer_size);
+socket_t net_listen(Uint32 addr, Uint16 port, int backlog,
+                    int send_buffer_size, int recv_buffer_size);
 socket_t net_accept(socket_t server_socket);
 
 // the _all versions wait/retry until len bytes have been written/read
@@ -28,6 +33,8 @@ ssize_t net_recv(socket_t socket, void *buf, size_t len);
 ssize_t net_recv_all(socket_t socket, void *buf, size_t len);
 ssize_t net_send(socket_t socket, const void *buf, size_t len);
 ssize_t net_send_all(socket_t socket, const void *buf, size_t len);
+// disable Nagle's algorithm, so that small writes are sent immediately
+SDL_bool net_set_nodelay(socket_t socket);
 // how is SHUT_RD (read), SHUT_WR (write) or SHUT_RDWR (both)
 SDL_bool net_shutdown(socket_t socket, int how);
 SDL_bool net_close(socket_t socket);
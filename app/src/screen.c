@@ -5,6 +5,7 @@
 #include <string.h>
 
 #include "compat.h"
+#include "events.h"
 #include "icon.xpm"
 #include "lock_util.h"
 #include "log.h"
@@ -12,6 +13,14 @@
 
 #define DISPLAY_MARGINS 96
 
+// delay after the last window resize before requesting a new video size, so
+// that the encoder is not restarted on every step of an interactive resize
+#define VIDEO_SIZE_DEBOUNCE_MS 500
+
+// window size used until the device screen size is known
+#define PROVISIONAL_WINDOW_WIDTH 360
+#define PROVISIONAL_WINDOW_HEIGHT 640
+
 #ifdef OVERRIDE_FONT_PATH
 # define DEFAULT_FONT_PATH OVERRIDE_FONT_PATH
 #else
@@ -180,24 +189,17 @@ void toolbar_build_rects(struct screen *screen, int toolbar_index,  int init_x,
 }
 
 SDL_bool toolbar_button_render_icon(struct screen *screen, int toolbar_index, int button_index) {
-    SDL_Surface* glyph_surface = TTF_RenderGlyph_Blended(screen->toolbar_font, screen->toolbar[toolbar_index].buttons[button_index].unicode_glyph, screen->toolbar[toolbar_index].icon_color);
-    if (!glyph_surface) return SDL_FALSE;
-    SDL_Texture* glyph_texture = SDL_CreateTextureFromSurface(screen->renderer, glyph_surface);
-    if (!glyph_texture) return SDL_FALSE;
-
-    SDL_FreeSurface(glyph_surface);
     SDL_Rect glyph_rect;
     glyph_rect.x = screen->toolbar[toolbar_index].buttons[button_index].rect.x + (screen->toolbar[toolbar_index].buttons[button_index].rect.w/2) - ((TOOLBAR_HEIGHT - TOOLBAR_BUTTON_SPACER*2 - (TOOLBAR_HEIGHT - TOOLBAR_BUTTON_ICON_WIDTH))/2);
     glyph_rect.y = screen->toolbar[toolbar_index].buttons[button_index].rect.y + (screen->toolbar[toolbar_index].buttons[button_index].rect.h/2) - ((TOOLBAR_HEIGHT - TOOLBAR_BUTTON_SPACER*2 - (TOOLBAR_HEIGHT - TOOLBAR_BUTTON_ICON_HEIGHT))/2);
     glyph_rect.w = TOOLBAR_HEIGHT - TOOLBAR_BUTTON_SPACER*2 - (TOOLBAR_HEIGHT-TOOLBAR_BUTTON_ICON_WIDTH);
     glyph_rect.h = TOOLBAR_HEIGHT - TOOLBAR_BUTTON_SPACER*2 - (TOOLBAR_HEIGHT-TOOLBAR_BUTTON_ICON_HEIGHT);
-    if (SDL_RenderCopy(screen->renderer, glyph_texture, NULL, &glyph_rect)) return SDL_FALSE;
-    SDL_DestroyTexture(glyph_texture);
+    if (SDL_RenderCopy(screen->renderer, screen->toolbar[toolbar_index].buttons[button_index].icon_texture, NULL, &glyph_rect)) return SDL_FALSE;
     return SDL_TRUE;
 }
 
 void toolbar_render(struct screen *screen) {
-    if (screen->toolbar_shown) {
+    if (screen->toolbar_shown && screen->toolbar_loaded) {
 
         int toolbarqty = sizeof(screen->toolbar) / sizeof(struct toolbar);
 
@@ -262,29 +264,79 @@ static inline SDL_Texture *create_texture(struct screen *screen, struct size fra
                              frame_size.width, frame_size.height);
 }
 
-SDL_bool screen_init_rendering(struct screen *screen,
-                               const char *device_name,
-                               struct size frame_size,
-                               SDL_bool always_on_top) {
-    //Initialize TTF Font
-    if (TTF_Init()==-1){
-        LOGW("Could not initialize TTF: %s", SDL_GetError());
-        return SDL_FALSE;
+// place the toolbars at their initial positions for the current frame size
+static void toolbar_build_default_rects(struct screen *screen) {
+    int toolbarqty = sizeof(screen->toolbar) / sizeof(struct toolbar);
+    for (int i=0; i<toolbarqty; i++) {
+        //TODO refactoring
+        if (i==0) toolbar_build_rects(screen, i, TOOLBAR_SPACER_WIDTH, TOOLBAR_SPACER_HEIGHT, 0, 0);
+        if (i==1) toolbar_build_rects(screen, i, TOOLBAR_SPACER_WIDTH, screen->frame_size.height - TOOLBAR_SPACER_HEIGHT - TOOLBAR_HEIGHT, 0, 0);
     }
-    
-    const char *font_path = getenv("MIRALLDROID_FONT_PATH");
-    if (!font_path) {
-        font_path = DEFAULT_FONT_PATH;
+}
+
+static void toolbar_save_layout(struct screen *screen, struct texture_pool_entry *entry) {
+    int toolbarqty = sizeof(screen->toolbar) / sizeof(struct toolbar);
+    for (int i=0; i<toolbarqty; i++) {
+        entry->toolbar_pos[i].x = screen->toolbar[i].rect.x;
+        entry->toolbar_pos[i].y = screen->toolbar[i].rect.y;
     }
-    screen->toolbar_font = TTF_OpenFont(font_path, TOOLBAR_BUTTON_ICON_HEIGHT);
-    if (!screen->toolbar_font) {
-        LOGW("Could not open font: %s", SDL_GetError());
-        return SDL_FALSE;
+    entry->toolbar_layout_saved = SDL_TRUE;
+}
+
+static void toolbar_restore_layout(struct screen *screen, const struct texture_pool_entry *entry) {
+    int toolbarqty = sizeof(screen->toolbar) / sizeof(struct toolbar);
+    for (int i=0; i<toolbarqty; i++) {
+        toolbar_build_rects(screen, i, entry->toolbar_pos[i].x, entry->toolbar_pos[i].y, 0, 0);
     }
+}
 
-    screen->frame_size = frame_size;
+static struct texture_pool_entry *texture_pool_find(struct screen *screen, struct size frame_size) {
+    for (int i = 0; i < TEXTURE_POOL_SIZE; ++i) {
+        struct texture_pool_entry *entry = &screen->texture_pool[i];
+        if (entry->texture
+                && entry->frame_size.width == frame_size.width
+                && entry->frame_size.height == frame_size.height) {
+            return entry;
+        }
+    }
+    return NULL;
+}
 
-    struct size window_size = get_initial_optimal_size(frame_size);
+// return the pool entry for the frame size, creating its texture if necessary
+// (the least recently used entry is evicted if the pool is full)
+static struct texture_pool_entry *texture_pool_acquire(struct screen *screen, struct size frame_size) {
+    struct texture_pool_entry *entry = texture_pool_find(screen, frame_size);
+    if (entry) {
+        LOGD("Reuse texture: %" PRIu16 "x%" PRIu16, frame_size.width, frame_size.height);
+    } else {
+        entry = &screen->texture_pool[0];
+        for (int i = 1; i < TEXTURE_POOL_SIZE && entry->texture; ++i) {
+            struct texture_pool_entry *candidate = &screen->texture_pool[i];
+            if (!candidate->texture || candidate->last_used < entry->last_used) {
+                entry = candidate;
+            }
+        }
+        if (entry->texture) {
+            LOGD("Evict texture: %" PRIu16 "x%" PRIu16,
+                 entry->frame_size.width, entry->frame_size.height);
+            SDL_DestroyTexture(entry->texture);
+        }
+
+        LOGD("New texture: %" PRIu16 "x%" PRIu16, frame_size.width, frame_size.height);
+        entry->texture = create_texture(screen, frame_size);
+        if (!entry->texture) {
+            return NULL;
+        }
+        entry->frame_size = frame_size;
+        entry->toolbar_layout_saved = SDL_FALSE;
+    }
+    entry->last_used = ++screen->texture_pool_clock;
+    return entry;
+}
+
+SDL_bool screen_init_rendering(struct screen *screen, SDL_bool always_on_top) {
+    // the device screen size is not known yet: the window is created hidden
+    // at a provisional size, and resized by screen_init_frame()
     Uint32 window_flags = SDL_WINDOW_HIDDEN | SDL_WINDOW_RESIZABLE;
 #ifdef HIDPI_SUPPORT
     window_flags |= SDL_WINDOW_ALLOW_HIGHDPI;
@@ -297,10 +349,12 @@ SDL_bool screen_init_rendering(struct screen *screen,
              "(compile with SDL >= 2.0.5 to enable it)");
 #endif
     }
-    screen->window = SDL_CreateWindow(device_name, SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
-                                      window_size.width, window_size.height, window_flags);
+    screen->window = SDL_CreateWindow("miralldroid", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+                                      PROVISIONAL_WINDOW_WIDTH, PROVISIONAL_WINDOW_HEIGHT,
+                                      window_flags);
     if (!screen->window) {
         LOGC("Could not create window: %s", SDL_GetError());
+        screen_destroy(screen);
         return SDL_FALSE;
     }
 
@@ -317,12 +371,6 @@ SDL_bool screen_init_rendering(struct screen *screen,
         return SDL_FALSE;
     }
 
-    if (SDL_RenderSetLogicalSize(screen->renderer, frame_size.width, frame_size.height)) {
-        LOGE("Could not set renderer logical size: %s", SDL_GetError());
-        screen_destroy(screen);
-        return SDL_FALSE;
-    }
-
     SDL_Surface *icon = read_xpm(icon_xpm);
     if (!icon) {
         LOGE("Could not load icon: %s", SDL_GetError());
@@ -332,21 +380,34 @@ SDL_bool screen_init_rendering(struct screen *screen,
     SDL_SetWindowIcon(screen->window, icon);
     SDL_FreeSurface(icon);
 
+    return SDL_TRUE;
+}
+
+SDL_bool screen_init_frame(struct screen *screen, const char *device_name,
+                           struct size frame_size) {
+    screen->frame_size = frame_size;
+
+    SDL_SetWindowTitle(screen->window, device_name);
+
+    struct size window_size = get_initial_optimal_size(frame_size);
+    SDL_SetWindowSize(screen->window, window_size.width, window_size.height);
+    SDL_SetWindowPosition(screen->window, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED);
+
+    if (SDL_RenderSetLogicalSize(screen->renderer, frame_size.width, frame_size.height)) {
+        LOGE("Could not set renderer logical size: %s", SDL_GetError());
+        return SDL_FALSE;
+    }
+
     LOGI("Initial texture: %" PRIu16 "x%" PRIu16, frame_size.width, frame_size.height);
-    screen->texture = create_texture(screen, frame_size);
-    if (!screen->texture) {
+    struct texture_pool_entry *entry = texture_pool_acquire(screen, frame_size);
+    if (!entry) {
         LOGC("Could not create texture: %s", SDL_GetError());
-        screen_destroy(screen);
         return SDL_FALSE;
     }
+    screen->texture = entry->texture;
+
+    toolbar_build_default_rects(screen);
 
-    int toolbarqty = sizeof(screen->toolbar) / sizeof(struct toolbar);
-    for (int i=0; i<toolbarqty; i++) {
-        //TODO refactoring
-        if (i==0) toolbar_build_rects(screen, i, TOOLBAR_SPACER_WIDTH, TOOLBAR_SPACER_HEIGHT, 0, 0);
-        if (i==1) toolbar_build_rects(screen, i, TOOLBAR_SPACER_WIDTH, screen->frame_size.height - TOOLBAR_SPACER_HEIGHT - TOOLBAR_HEIGHT, 0, 0);
-    }
-    
     return SDL_TRUE;
 }
 
@@ -354,13 +415,81 @@ void screen_show_window(struct screen *screen) {
     SDL_ShowWindow(screen->window);
 }
 
-void screen_destroy(struct screen *screen) {
-    if (screen->toolbar_font) {
-        TTF_CloseFont(screen->toolbar_font);
+static void toolbar_destroy_icons(struct screen *screen) {
+    int toolbarqty = sizeof(screen->toolbar) / sizeof(struct toolbar);
+    for (int i=0; i<toolbarqty; i++) {
+        int buttonqty = sizeof(screen->toolbar[i].buttons) / sizeof(struct button);
+        for (int j=0; j<buttonqty; j++) {
+            if (screen->toolbar[i].buttons[j].icon_texture) {
+                SDL_DestroyTexture(screen->toolbar[i].buttons[j].icon_texture);
+                screen->toolbar[i].buttons[j].icon_texture = NULL;
+            }
+        }
+    }
+}
+
+// open the font and render the button icons into textures
+// the font is closed once the icons are rendered, it is not needed anymore
+static SDL_bool toolbar_load(struct screen *screen) {
+    if (TTF_Init()==-1){
+        LOGW("Could not initialize TTF: %s", SDL_GetError());
+        return SDL_FALSE;
+    }
+
+    const char *font_path = getenv("MIRALLDROID_FONT_PATH");
+    if (!font_path) {
+        font_path = DEFAULT_FONT_PATH;
+    }
+    TTF_Font *font = TTF_OpenFont(font_path, TOOLBAR_BUTTON_ICON_HEIGHT);
+    if (!font) {
+        LOGW("Could not open font: %s", SDL_GetError());
         TTF_Quit();
+        return SDL_FALSE;
     }
-    if (screen->texture) {
-        SDL_DestroyTexture(screen->texture);
+
+    SDL_bool ret = SDL_TRUE;
+    int toolbarqty = sizeof(screen->toolbar) / sizeof(struct toolbar);
+    for (int i=0; i<toolbarqty && ret; i++) {
+        struct toolbar *toolbar = &screen->toolbar[i];
+        int buttonqty = sizeof(toolbar->buttons) / sizeof(struct button);
+        for (int j=0; j<buttonqty; j++) {
+            SDL_Surface *glyph_surface = TTF_RenderGlyph_Blended(font, toolbar->buttons[j].unicode_glyph, toolbar->icon_color);
+            if (!glyph_surface) {
+                LOGW("Could not render Toolbar[%d] button [%d] icon: %s", i, j, SDL_GetError());
+                ret = SDL_FALSE;
+                break;
+            }
+            toolbar->buttons[j].icon_texture = SDL_CreateTextureFromSurface(screen->renderer, glyph_surface);
+            SDL_FreeSurface(glyph_surface);
+            if (!toolbar->buttons[j].icon_texture) {
+                LOGW("Could not create Toolbar[%d] button [%d] icon texture: %s", i, j, SDL_GetError());
+                ret = SDL_FALSE;
+                break;
+            }
+        }
+    }
+
+    TTF_CloseFont(font);
+    TTF_Quit();
+
+    if (!ret) {
+        toolbar_destroy_icons(screen);
+        return SDL_FALSE;
+    }
+
+    screen->toolbar_loaded = SDL_TRUE;
+    return SDL_TRUE;
+}
+
+void screen_destroy(struct screen *screen) {
+    if (screen->video_size_timer) {
+        SDL_RemoveTimer(screen->video_size_timer);
+    }
+    toolbar_destroy_icons(screen);
+    for (int i = 0; i < TEXTURE_POOL_SIZE; ++i) {
+        if (screen->texture_pool[i].texture) {
+            SDL_DestroyTexture(screen->texture_pool[i].texture);
+        }
     }
     if (screen->renderer) {
         SDL_DestroyRenderer(screen->renderer);
@@ -370,7 +499,8 @@ void screen_destroy(struct screen *screen) {
     }
 }
 
-// recreate the texture and resize the window if the frame size has changed
+// switch to the texture for the new frame size (reusing it from the texture
+// pool if possible) and resize the window if the frame size has changed
 static SDL_bool prepare_for_frame(struct screen *screen, struct size new_frame_size) {
     if (screen->frame_size.width != new_frame_size.width || screen->frame_size.height != new_frame_size.height) {
         if (SDL_RenderSetLogicalSize(screen->renderer, new_frame_size.width, new_frame_size.height)) {
@@ -378,32 +508,46 @@ static SDL_bool prepare_for_frame(struct screen *screen, struct size new_frame_s
             return SDL_FALSE;
         }
 
-        // frame dimension changed, destroy texture
-        SDL_DestroyTexture(screen->texture);
+        // keep the toolbar layout of the previous frame size, to restore it
+        // when the device rotates back
+        struct texture_pool_entry *previous = texture_pool_find(screen, screen->frame_size);
+        if (previous) {
+            toolbar_save_layout(screen, previous);
+        }
+
+        struct texture_pool_entry *entry = texture_pool_acquire(screen, new_frame_size);
+        if (!entry) {
+            LOGC("Could not create texture: %s", SDL_GetError());
+            return SDL_FALSE;
+        }
 
         struct size current_size = get_window_size(screen);
-        struct size target_size = {
-            (Uint32) current_size.width * new_frame_size.width / screen->frame_size.width,
-            (Uint32) current_size.height * new_frame_size.height / screen->frame_size.height,
-        };
+        struct size target_size;
+        if (screen->fit_video_to_window) {
+            // the video size follows the window size, not the reverse: keep
+            // the window size (rotated if the device rotated)
+            SDL_bool was_portrait = screen->frame_size.width < screen->frame_size.height;
+            SDL_bool is_portrait = new_frame_size.width < new_frame_size.height;
+            if (was_portrait != is_portrait) {
+                target_size.width = current_size.height;
+                target_size.height = current_size.width;
+            } else {
+                target_size = current_size;
+            }
+        } else {
+            target_size.width = (Uint32) current_size.width * new_frame_size.width / screen->frame_size.width;
+            target_size.height = (Uint32) current_size.height * new_frame_size.height / screen->frame_size.height;
+        }
         target_size = get_optimal_size(target_size, new_frame_size);
         set_window_size(screen, target_size);
 
         screen->frame_size = new_frame_size;
+        screen->texture = entry->texture;
 
-        LOGD("New texture: %" PRIu16 "x%" PRIu16,
-                     screen->frame_size.width, screen->frame_size.height);
-        screen->texture = create_texture(screen, new_frame_size);
-        if (!screen->texture) {
-            LOGC("Could not create texture: %s", SDL_GetError());
-            return SDL_FALSE;
-        }
-
-        int toolbarqty = sizeof(screen->toolbar) / sizeof(struct toolbar);
-        for (int i=0; i<toolbarqty; i++) {
-            //TODO refactoring
-            if (i==0) toolbar_build_rects(screen, i, TOOLBAR_SPACER_WIDTH, TOOLBAR_SPACER_HEIGHT, 0, 0);
-            if (i==1) toolbar_build_rects(screen, i, TOOLBAR_SPACER_WIDTH, screen->frame_size.height - TOOLBAR_SPACER_HEIGHT - TOOLBAR_HEIGHT, 0, 0);
+        if (entry->toolbar_layout_saved) {
+            toolbar_restore_layout(screen, entry);
+        } else {
+            toolbar_build_default_rects(screen);
         }
     }
 
@@ -418,9 +562,16 @@ static void update_texture(struct screen *screen, const AVFrame *frame) {
             frame->data[2], frame->linesize[2]);
 }
 
-SDL_bool screen_update_frame(struct screen *screen, struct frames *frames) {
+SDL_bool screen_update_frame(struct screen *screen, struct frames *frames,
+                             SDL_bool *repeated) {
     mutex_lock(frames->mutex);
+    *repeated = frames_is_rendering_frame_repeated(frames);
     const AVFrame *frame = frames_consume_rendered_frame(frames);
+    if (*repeated) {
+        // the texture already contains this picture
+        mutex_unlock(frames->mutex);
+        return SDL_TRUE;
+    }
     struct size new_frame_size = {frame->width, frame->height};
     if (!prepare_for_frame(screen, new_frame_size)) {
         mutex_unlock(frames->mutex);
@@ -461,10 +612,70 @@ void screen_switch_fullscreen(struct screen *screen) {
 }
 
 void toolbar_toggle(struct screen *screen) {
+    if (!screen->toolbar_shown && !screen->toolbar_loaded && !toolbar_load(screen)) {
+        LOGW("Onscreen menus are not available");
+        return;
+    }
     screen->toolbar_shown = (screen->toolbar_shown) ? SDL_FALSE : SDL_TRUE;
     LOGD("Onscreen menus are %s", screen->toolbar_shown ? "shown" : "hidden");
 }
 
+static Uint32 push_video_size_request(Uint32 interval, void *param) {
+    (void) interval;
+    (void) param;
+    // called from the timer thread
+    SDL_Event event;
+    event.type = EVENT_VIDEO_SIZE_REQUEST;
+    SDL_PushEvent(&event);
+    return 0; // do not repeat
+}
+
+void screen_schedule_video_size_request(struct screen *screen) {
+    if (screen->video_size_timer) {
+        // restart the delay (no-op if the timer already fired)
+        SDL_RemoveTimer(screen->video_size_timer);
+    }
+    screen->video_size_timer = SDL_AddTimer(VIDEO_SIZE_DEBOUNCE_MS,
+                                            push_video_size_request, NULL);
+    if (!screen->video_size_timer) {
+        LOGW("Could not schedule the video size request: %s", SDL_GetError());
+    }
+}
+
+void screen_handle_window_event(struct screen *screen,
+                                const SDL_WindowEvent *event) {
+    if (event->event == SDL_WINDOWEVENT_SIZE_CHANGED
+            && screen->fit_video_to_window && screen->has_frame) {
+        screen_schedule_video_size_request(screen);
+    }
+}
+
+Uint16 screen_get_displayed_max_size(const struct screen *screen) {
+    struct size frame_size = screen->frame_size;
+    if (frame_size.width == 0 || frame_size.height == 0) {
+        return 0;
+    }
+    // in pixels, which may differ from the window size on HiDPI displays
+    int w;
+    int h;
+    if (SDL_GetRendererOutputSize(screen->renderer, &w, &h)) {
+        LOGW("Could not get renderer output size: %s", SDL_GetError());
+        return 0;
+    }
+    // the frame is scaled to fit, keeping the aspect ratio
+    Uint32 content_width;
+    Uint32 content_height;
+    if ((Uint32) frame_size.width * h > (Uint32) frame_size.height * w) {
+        content_width = w;
+        content_height = (Uint32) frame_size.height * w / frame_size.width;
+    } else {
+        content_width = (Uint32) frame_size.width * h / frame_size.height;
+        content_height = h;
+    }
+    Uint32 max_size = MAX(content_width, content_height);
+    return max_size < 0x10000 ? (Uint16) max_size : 0xffff;
+}
+
 void screen_resize_to_fit(struct screen *screen) {
     if (!screen->fullscreen) {
         struct size optimal_size = get_optimal_window_size(screen, screen->frame_size);
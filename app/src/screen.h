@@ -22,6 +22,7 @@ struct button {
     SDL_Rect rect;
     SDL_bool mouseover;
     Uint16 unicode_glyph;
+    SDL_Texture *icon_texture; // rendered once, when the toolbar is loaded
 };
 
 struct toolbar {
@@ -37,19 +38,38 @@ struct toolbar {
     struct button buttons[3];
 };
 
+// number of textures kept alive, so that switching back to a previous frame
+// size (typically on device rotation) does not allocate a new texture
+#define TEXTURE_POOL_SIZE 4
+
+struct texture_pool_entry {
+    SDL_Texture *texture; // NULL if the entry is unused
+    struct size frame_size;
+    // toolbar positions for this frame size (one layout per orientation)
+    SDL_bool toolbar_layout_saved;
+    SDL_Point toolbar_pos[2];
+    Uint32 last_used;
+};
+
 struct screen {
     SDL_Window *window;
     SDL_Renderer *renderer;
-    SDL_Texture *texture;
+    SDL_Texture *texture; // the texture of the current texture pool entry
+    struct texture_pool_entry texture_pool[TEXTURE_POOL_SIZE];
+    Uint32 texture_pool_clock; // incremented on each texture pool access
     struct size frame_size;
     //used only in fullscreen mode to know the windowed window size
     struct size windowed_window_size;
     SDL_bool has_frame;
     SDL_bool fullscreen;
     SDL_bool toolbar_shown;
-    TTF_Font* toolbar_font;
+    // the font and the button icons are loaded on the first toolbar show
+    SDL_bool toolbar_loaded;
     int toolbar_zindex_sort_down_to_top[2];
     struct toolbar toolbar[2];
+    // request a video size matching the window size when it is resized
+    SDL_bool fit_video_to_window;
+    SDL_TimerID video_size_timer; // the pending (debounced) request, if any
 };
 
 #define TOOLBAR_SPACER_WIDTH 200
@@ -63,6 +83,8 @@ struct screen {
     .window = NULL,                                           \
     .renderer = NULL,                                         \
     .texture = NULL,                                          \
+    .texture_pool = {{0}},                                    \
+    .texture_pool_clock = 0,                                  \
     .frame_size = {                                           \
         .width = 0,                                           \
         .height = 0,                                          \
@@ -73,9 +95,11 @@ struct screen {
     },                                                        \
     .has_frame = SDL_FALSE,                                   \
     .fullscreen = SDL_FALSE,                                  \
-    .toolbar_shown = SDL_TRUE,                                \
-    .toolbar_font = NULL,                                     \
+    .toolbar_shown = SDL_FALSE,                               \
+    .toolbar_loaded = SDL_FALSE,                              \
     .toolbar_zindex_sort_down_to_top={0,1},                   \
+    .fit_video_to_window = SDL_FALSE,                         \
+    .video_size_timer = 0,                                    \
         .toolbar[0] = {                                       \
         .shown = SDL_TRUE,                                    \
         .rect = {0,0,0,0},                                    \
@@ -90,19 +114,22 @@ struct screen {
             .type = POWER,                                    \
             .rect = {0,0,0,0},                                \
             .mouseover = SDL_FALSE,                           \
-            .unicode_glyph = u'\ue801'                        \
+            .unicode_glyph = u'\ue801',                       \
+            .icon_texture = NULL                              \
         },                                                    \
         .buttons[1]= {                                        \
             .type = VOLUME_DOWN,                              \
             .rect = {0,0,0,0},                                \
             .mouseover = SDL_FALSE,                           \
-            .unicode_glyph = u'\ue804'                        \
+            .unicode_glyph = u'\ue804',                       \
+            .icon_texture = NULL                              \
         },                                                    \
         .buttons[2]= {                                        \
             .type = VOLUME_UP,                                \
             .rect = {0,0,0,0},                                \
             .mouseover = SDL_FALSE,                           \
-            .unicode_glyph = u'\ue805'                        \
+            .unicode_glyph = u'\ue805',                       \
+            .icon_texture = NULL                              \
         }                                                     \
     },                                                        \
     .toolbar[1] = {                                           \
@@ -119,19 +146,22 @@ struct screen {
             .type = SWITCH,                                   \
             .rect = {0,0,0,0},                                \
             .mouseover = SDL_FALSE,                           \
-            .unicode_glyph = u'\ue803'                        \
+            .unicode_glyph = u'\ue803',                       \
+            .icon_texture = NULL                              \
         },                                                    \
         .buttons[1]= {                                        \
             .type = HOME,                                     \
             .rect = {0,0,0,0},                                \
             .mouseover = SDL_FALSE,                           \
-            .unicode_glyph = u'\ue800'                        \
+            .unicode_glyph = u'\ue800',                       \
+            .icon_texture = NULL                              \
         },                                                    \
         .buttons[2]= {                                        \
             .type = BACK,                                     \
             .rect = {0,0,0,0},                                \
             .mouseover = SDL_FALSE,                           \
-            .unicode_glyph = u'\ue802'                        \
+            .unicode_glyph = u'\ue802',                       \
+            .icon_texture = NULL                              \
         }                                                     \
     }                                                         \
 }
@@ -142,20 +172,26 @@ SDL_bool sdl_init_and_configure(void);
 // initialize default values
 void screen_init(struct screen *screen);
 
-// initialize screen, create window, renderer and texture (window is hidden)
-SDL_bool screen_init_rendering(struct screen *screen,
-                               const char *device_name,
-                               struct size frame_size,
-                               SDL_bool always_on_top);
+// initialize screen, create window and renderer (window is hidden)
+// does not depend on the device, so it may run while the server is starting
+SDL_bool screen_init_rendering(struct screen *screen, SDL_bool always_on_top);
+
+// set the device name and frame size, resize the window and create the
+// initial texture
+SDL_bool screen_init_frame(struct screen *screen, const char *device_name,
+                           struct size frame_size);
 
 // show the window
 void screen_show_window(struct screen *screen);
 
-// destroy window, renderer and texture (if any)
+// destroy window, renderer and textures (if any)
 void screen_destroy(struct screen *screen);
 
 // resize if necessary and write the rendered frame into the texture
-SDL_bool screen_update_frame(struct screen *screen, struct frames *frames);
+// repeated is set to true if the frame did not change the picture (in that
+// case, the texture is not updated and there is nothing new to render)
+SDL_bool screen_update_frame(struct screen *screen, struct frames *frames,
+                             SDL_bool *repeated);
 
 // render the texture to the renderer
 void screen_render(struct screen *screen);
@@ -166,6 +202,18 @@ void screen_switch_fullscreen(struct screen *screen);
 // toggle onscreen_menus
 void toolbar_toggle(struct screen *screen);
 
+// to be called on window events, to schedule a video size request (pushed as
+// EVENT_VIDEO_SIZE_REQUEST) once the window size is stable
+void screen_handle_window_event(struct screen *screen,
+                                const SDL_WindowEvent *event);
+
+// schedule a video size request, even if the window size did not change
+void screen_schedule_video_size_request(struct screen *screen);
+
+// get the greatest dimension, in pixels, of the video displayed in the window
+// (0 if unknown)
+Uint16 screen_get_displayed_max_size(const struct screen *screen);
+
 // resize window to optimal size (remove black borders)
 void screen_resize_to_fit(struct screen *screen);
 
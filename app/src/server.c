@@ -8,6 +8,7 @@
 #include <SDL2/SDL_timer.h>
 
 #include "config.h"
+#include "handshake.h"
 #include "log.h"
 #include "net.h"
 
@@ -21,6 +22,15 @@
 
 #define DEVICE_SERVER_PATH "/data/local/tmp/miralldroid-server.jar"
 
+// the first byte sent by the server on each socket
+#define SOCKET_TYPE_VIDEO 0
+#define SOCKET_TYPE_CONTROL 1
+
+// the control socket only carries small messages, keep its buffer small so
+// that stale input never accumulates; the video socket receives large bursts
+#define CONTROL_SOCKET_SEND_BUFFER_SIZE (16 * 1024)
+#define VIDEO_SOCKET_RECV_BUFFER_SIZE (1024 * 1024)
+
 static const char *get_server_path(void) {
     const char *server_path = getenv("MIRALLDROID_SERVER_PATH");
     if (!server_path) {
@@ -71,25 +81,18 @@ static SDL_bool disable_tunnel(struct server *server) {
     return disable_tunnel_reverse(server->serial);
 }
 
-static process_t execute_server(const char *serial,
-                                Uint16 max_size, Uint32 bit_rate,
-                                SDL_bool tunnel_forward, const char *crop,
-                                SDL_bool send_frame_meta) {
-    char max_size_string[6];
-    char bit_rate_string[11];
-    sprintf(max_size_string, "%"PRIu16, max_size);
-    sprintf(bit_rate_string, "%"PRIu32, bit_rate);
+static process_t execute_server(const char *serial, SDL_bool tunnel_forward) {
+    // the other options are sent in the handshake, once connected
+    char handshake_string[16];
+    sprintf(handshake_string, "handshake=%d", HANDSHAKE_VERSION);
     const char *const cmd[] = {
         "shell",
         "CLASSPATH=/data/local/tmp/miralldroid-server.jar",
         "app_process",
         "/", // unused
         "org.vispo.miralldroid.Server",
-        max_size_string,
-        bit_rate_string,
+        handshake_string,
         tunnel_forward ? "true" : "false",
-        crop ? crop : "-",
-        send_frame_meta ? "true" : "false",
     };
     return adb_execute(serial, cmd, sizeof(cmd) / sizeof(cmd[0]));
 }
@@ -97,11 +100,17 @@ static process_t execute_server(const char *serial,
 #define IPV4_LOCALHOST 0x7F000001
 
 static socket_t listen_on_port(Uint16 port) {
-    return net_listen(IPV4_LOCALHOST, port, 1);
+    // the type of an accepted socket is unknown until its first byte is read,
+    // so both inherit both sizes: the video socket never sends and the
+    // control socket receives nothing large, so the other values are harmless
+    return net_listen(IPV4_LOCALHOST, port, 1, CONTROL_SOCKET_SEND_BUFFER_SIZE,
+                      VIDEO_SOCKET_RECV_BUFFER_SIZE);
 }
 
 static socket_t connect_and_read_byte(Uint16 port) {
-    socket_t socket = net_connect(IPV4_LOCALHOST, port);
+    // this is the video socket
+    socket_t socket = net_connect(IPV4_LOCALHOST, port, 0,
+                                  VIDEO_SOCKET_RECV_BUFFER_SIZE);
     if (socket == INVALID_SOCKET) {
         return INVALID_SOCKET;
     }
@@ -111,6 +120,7 @@ static socket_t connect_and_read_byte(Uint16 port) {
     // is not listening, so read one byte to detect a working connection
     if (net_recv_all(socket, &byte, 1) != 1) {
         // the server is not listening yet behind the adb tunnel
+        net_close(socket);
         return INVALID_SOCKET;
     }
     return socket;
@@ -146,8 +156,7 @@ void server_init(struct server *server) {
 }
 
 SDL_bool server_start(struct server *server, const char *serial,
-                      Uint16 local_port, Uint16 max_size, Uint32 bit_rate,
-                      const char *crop, SDL_bool send_frame_meta) {
+                      Uint16 local_port) {
     server->local_port = local_port;
 
     if (serial) {
@@ -186,9 +195,7 @@ SDL_bool server_start(struct server *server, const char *serial,
     }
 
     // server will connect to our server socket
-    server->process = execute_server(serial, max_size, bit_rate,
-                                     server->tunnel_forward, crop,
-                                     send_frame_meta);
+    server->process = execute_server(serial, server->tunnel_forward);
 
     if (server->process == PROCESS_NONE) {
         if (!server->tunnel_forward) {
@@ -204,17 +211,82 @@ SDL_bool server_start(struct server *server, const char *serial,
     return SDL_TRUE;
 }
 
-socket_t server_connect_to(struct server *server) {
-    if (!server->tunnel_forward) {
-        server->device_socket = net_accept(server->server_socket);
-    } else {
-        Uint32 attempts = 100;
-        Uint32 delay = 100; // ms
-        server->device_socket = connect_to_server(server->local_port, attempts, delay);
+static SDL_bool read_socket_type(socket_t socket, Uint8 *type) {
+    if (net_recv_all(socket, type, 1) != 1) {
+        LOGE("Could not read socket type");
+        return SDL_FALSE;
     }
+    return SDL_TRUE;
+}
 
-    if (server->device_socket == INVALID_SOCKET) {
-        return INVALID_SOCKET;
+// accept the video and control connections from the server
+static SDL_bool accept_sockets(struct server *server) {
+    // the server connects the video socket first, but through the adb tunnel
+    // the connections may be accepted in any order, so each socket starts
+    // with its type
+    for (int i = 0; i < 2; ++i) {
+        socket_t socket = net_accept(server->server_socket);
+        if (socket == INVALID_SOCKET) {
+            return SDL_FALSE;
+        }
+        Uint8 type;
+        if (!read_socket_type(socket, &type)) {
+            net_close(socket);
+            return SDL_FALSE;
+        }
+        socket_t *target;
+        if (type == SOCKET_TYPE_VIDEO) {
+            target = &server->video_socket;
+        } else if (type == SOCKET_TYPE_CONTROL) {
+            target = &server->control_socket;
+        } else {
+            LOGE("Unknown socket type: %d", (int) type);
+            net_close(socket);
+            return SDL_FALSE;
+        }
+        if (*target != INVALID_SOCKET) {
+            LOGE("Duplicate socket type: %d", (int) type);
+            net_close(socket);
+            return SDL_FALSE;
+        }
+        *target = socket;
+    }
+    return SDL_TRUE;
+}
+
+// connect the video socket, then the control socket, through "adb forward"
+static SDL_bool connect_sockets(struct server *server) {
+    Uint32 attempts = 100;
+    Uint32 delay = 100; // ms
+    // the first byte of the video socket is read by connect_and_read_byte()
+    server->video_socket = connect_to_server(server->local_port, attempts, delay);
+    if (server->video_socket == INVALID_SOCKET) {
+        return SDL_FALSE;
+    }
+
+    // the server is now listening, no need to retry
+    server->control_socket = net_connect(IPV4_LOCALHOST, server->local_port,
+                                         CONTROL_SOCKET_SEND_BUFFER_SIZE, 0);
+    if (server->control_socket == INVALID_SOCKET) {
+        return SDL_FALSE;
+    }
+    Uint8 type;
+    if (!read_socket_type(server->control_socket, &type)) {
+        return SDL_FALSE;
+    }
+    if (type != SOCKET_TYPE_CONTROL) {
+        LOGE("Unexpected socket type: %d", (int) type);
+        return SDL_FALSE;
+    }
+    return SDL_TRUE;
+}
+
+SDL_bool server_connect_to(struct server *server) {
+    SDL_bool ok = server->tunnel_forward ? connect_sockets(server)
+                                         : accept_sockets(server);
+    if (!ok) {
+        // the sockets which are connected are closed by server_destroy()
+        return SDL_FALSE;
     }
 
     if (!server->tunnel_forward) {
@@ -226,7 +298,10 @@ socket_t server_connect_to(struct server *server) {
     disable_tunnel(server); // ignore failure
     server->tunnel_enabled = SDL_FALSE;
 
-    return server->device_socket;
+    // control events are small and latency-sensitive: send them immediately
+    net_set_nodelay(server->control_socket);
+
+    return SDL_TRUE;
 }
 
 void server_stop(struct server *server) {
@@ -249,8 +324,11 @@ void server_destroy(struct server *server) {
     if (server->server_socket != INVALID_SOCKET) {
         close_socket(&server->server_socket);
     }
-    if (server->device_socket != INVALID_SOCKET) {
-        close_socket(&server->device_socket);
+    if (server->video_socket != INVALID_SOCKET) {
+        close_socket(&server->video_socket);
+    }
+    if (server->control_socket != INVALID_SOCKET) {
+        close_socket(&server->control_socket);
     }
     SDL_free((void *) server->serial);
 }
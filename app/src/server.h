@@ -2,13 +2,15 @@
 #define SERVER_H
 
 #include "command.h"
+#include "device.h"
 #include "net.h"
 
 struct server {
     const char *serial;
     process_t process;
     socket_t server_socket; // only used if !tunnel_forward
-    socket_t device_socket;
+    socket_t video_socket;
+    socket_t control_socket;
     Uint16 local_port;
     SDL_bool tunnel_enabled;
     SDL_bool tunnel_forward; // use "adb forward" instead of "adb reverse"
@@ -19,7 +21,8 @@ struct server {
     .serial = NULL,                       \
     .process = PROCESS_NONE,              \
     .server_socket = INVALID_SOCKET,      \
-    .device_socket = INVALID_SOCKET,      \
+    .video_socket = INVALID_SOCKET,       \
+    .control_socket = INVALID_SOCKET,     \
     .local_port = 0,                      \
     .tunnel_enabled = SDL_FALSE,          \
     .tunnel_forward = SDL_FALSE,          \
@@ -30,12 +33,13 @@ struct server {
 void server_init(struct server *server);
 
 // push, enable tunnel et start the server
+// the options are sent afterwards, by device_send_options()
 SDL_bool server_start(struct server *server, const char *serial,
-                      Uint16 local_port, Uint16 max_size, Uint32 bit_rate,
-                      const char *crop, SDL_bool send_frame_meta);
+                      Uint16 local_port);
 
 // block until the communication with the server is established
-socket_t server_connect_to(struct server *server);
+// on success, video_socket and control_socket are connected
+SDL_bool server_connect_to(struct server *server);
 
 // disconnect and kill the server process
 void server_stop(struct server *server);
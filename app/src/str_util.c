@@ -40,6 +40,25 @@ truncated:
     return n;
 }
 
+size_t utf8_truncation_index(const char *utf8, size_t max_len) {
+    // do not compute the whole length, the string may be far longer than
+    // max_len (e.g. when a large text is split into chunks)
+    size_t len = 0;
+    while (len <= max_len && utf8[len]) {
+        ++len;
+    }
+    if (len <= max_len) {
+        return len;
+    }
+    len = max_len;
+    // see UTF-8 encoding <https://en.wikipedia.org/wiki/UTF-8#Description>
+    // continuation bytes (10xxxxxx) must not be the first byte of the tail
+    while (len && (utf8[len] & 0xc0) == 0x80) {
+        --len;
+    }
+    return len;
+}
+
 char *strquote(const char *src) {
     size_t len = strlen(src);
     char *quoted = malloc(len + 3);
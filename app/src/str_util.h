@@ -16,6 +16,11 @@ size_t xstrncpy(char *dest, const char *src, size_t n);
 // occurred, or n if truncated
 size_t xstrjoin(char *dst, const char *const tokens[], char sep, size_t n);
 
+// return the index to truncate a UTF-8 string at a char boundary so that its
+// length does not exceed max_len (the result is strlen(utf8) if it fits)
+// at most max_len + 1 bytes are read
+size_t utf8_truncation_index(const char *utf8, size_t max_len);
+
 // quote a string
 // returns the new allocated string, to be freed by the caller
 char *strquote(const char *src);
@@ -0,0 +1,99 @@
+#include <assert.h>
+
+#include "abr.h"
+
+#define TARGET 100
+#define MIN 250000
+#define MAX 8000000
+
+static void test_compute_bit_rate_overuse(void) {
+    // the queue delay exceeds the target: decrease by 15%
+    Uint32 bit_rate = abr_compute_bit_rate(4000000, 3900000, 150, SDL_FALSE,
+                                           TARGET, MIN, MAX);
+    assert(bit_rate == 3400000);
+
+    // the throughput is far below: do not request more than 90% of it
+    bit_rate = abr_compute_bit_rate(4000000, 2000000, 150, SDL_FALSE,
+                                    TARGET, MIN, MAX);
+    assert(bit_rate == 1800000);
+
+    // the decoder cannot keep up, even if the network is fine
+    bit_rate = abr_compute_bit_rate(4000000, 3900000, 0, SDL_TRUE,
+                                    TARGET, MIN, MAX);
+    assert(bit_rate == 3400000);
+
+    // never below the minimum
+    bit_rate = abr_compute_bit_rate(MIN, 100000, 500, SDL_FALSE,
+                                    TARGET, MIN, MAX);
+    assert(bit_rate == MIN);
+}
+
+static void test_compute_bit_rate_underuse(void) {
+    // the queues are empty: increase by 8%
+    Uint32 bit_rate = abr_compute_bit_rate(4000000, 3900000, 10, SDL_FALSE,
+                                           TARGET, MIN, MAX);
+    assert(bit_rate == 4320000);
+
+    // never above the maximum
+    bit_rate = abr_compute_bit_rate(7900000, 7800000, 10, SDL_FALSE,
+                                    TARGET, MIN, MAX);
+    assert(bit_rate == MAX);
+
+    // the current bit-rate is not used (static screen): keep it
+    bit_rate = abr_compute_bit_rate(4000000, 100000, 10, SDL_FALSE,
+                                    TARGET, MIN, MAX);
+    assert(bit_rate == 4000000);
+
+    // between target/2 and target: keep it
+    bit_rate = abr_compute_bit_rate(4000000, 3900000, 70, SDL_FALSE,
+                                    TARGET, MIN, MAX);
+    assert(bit_rate == 4000000);
+}
+
+static void test_update_from_packets(void) {
+    struct abr abr;
+    SDL_bool ok = abr_init(&abr, MAX, TARGET);
+    assert(ok);
+    // fake clock, independent of SDL_GetTicks()
+    abr.window_start = 0;
+
+    // 1 Mbit in 500 ms, the delay (relative to the PTS) increases by 30 ms
+    // for every packet: the queue grows
+    for (int i = 0; i < 10; ++i) {
+        uint64_t pts = i * UINT64_C(50000); // µs
+        Uint32 now = 1000 + i * 50 + i * 30;
+        abr_add_packet(&abr, pts, 12500, now);
+    }
+
+    Uint32 bit_rate;
+    ok = abr_update(&abr, 400, &bit_rate);
+    assert(!ok); // the interval is not elapsed
+
+    ok = abr_update(&abr, 500, &bit_rate);
+    assert(ok);
+    // average delay 1135 ms, base delay 1000 ms
+    assert(abr.stats.queue_delay == 135);
+    assert(abr.stats.throughput == 2000000);
+    // limited by the measured throughput
+    assert(bit_rate == 1800000);
+    assert(abr.stats.bit_rate == 1800000);
+    assert(abr.stats.decreases == 1);
+
+    // nothing received: no decision
+    ok = abr_update(&abr, 1000, &bit_rate);
+    assert(!ok);
+
+    // lowering the max lowers the current bit-rate
+    ok = abr_set_max_bit_rate(&abr, 1000000);
+    assert(ok);
+    assert(abr.stats.bit_rate == 1000000);
+
+    abr_destroy(&abr);
+}
+
+int main(void) {
+    test_compute_bit_rate_overuse();
+    test_compute_bit_rate_underuse();
+    test_update_from_packets();
+    return 0;
+}
@@ -10,7 +10,9 @@ static void test_control_event_queue_empty(void) {
 
     assert(control_event_queue_is_empty(&queue));
 
-    struct control_event dummy_event;
+    struct control_event dummy_event = {
+        .type = CONTROL_EVENT_TYPE_COMMAND,
+    };
     SDL_bool push_ok = control_event_queue_push(&queue, &dummy_event);
     assert(push_ok);
     assert(!control_event_queue_is_empty(&queue));
@@ -32,7 +34,9 @@ static void test_control_event_queue_full(void) {
 
     assert(!control_event_queue_is_full(&queue));
 
-    struct control_event dummy_event;
+    struct control_event dummy_event = {
+        .type = CONTROL_EVENT_TYPE_COMMAND,
+    };
     // fill the queue
     while (control_event_queue_push(&queue, &dummy_event));
 
@@ -87,9 +91,277 @@ static void test_control_event_queue_push_take(void) {
     control_event_queue_destroy(&queue);
 }
 
+static struct control_event mouse_event(enum android_motionevent_action action,
+                                        Sint32 x, Sint32 y) {
+    return (struct control_event) {
+        .type = CONTROL_EVENT_TYPE_MOUSE,
+        .mouse_event = {
+            .action = action,
+            .buttons = AMOTION_EVENT_BUTTON_PRIMARY,
+            .position = {
+                .point = {x, y},
+                .screen_size = {1080, 1920},
+            },
+        },
+    };
+}
+
+static void test_control_event_queue_coalesce_mouse_move(void) {
+    struct control_event_queue queue;
+    SDL_bool init_ok = control_event_queue_init(&queue);
+    assert(init_ok);
+
+    SDL_bool ok;
+
+    struct control_event event = mouse_event(AMOTION_EVENT_ACTION_DOWN, 1, 1);
+    ok = control_event_queue_push(&queue, &event);
+    assert(ok);
+    for (int i = 2; i <= 10; ++i) {
+        event = mouse_event(AMOTION_EVENT_ACTION_MOVE, i, 2 * i);
+        ok = control_event_queue_push(&queue, &event);
+        assert(ok);
+    }
+    event = mouse_event(AMOTION_EVENT_ACTION_UP, 10, 20);
+    ok = control_event_queue_push(&queue, &event);
+    assert(ok);
+
+    // the 9 moves are merged into a single one
+    assert(queue.coalesced_count == 8);
+
+    ok = control_event_queue_take(&queue, &event);
+
+    assert(ok);
+    assert(event.mouse_event.action == AMOTION_EVENT_ACTION_DOWN);
+    ok = control_event_queue_take(&queue, &event);
+    assert(ok);
+    assert(event.mouse_event.action == AMOTION_EVENT_ACTION_MOVE);
+    assert(event.mouse_event.position.point.x == 10);
+    assert(event.mouse_event.position.point.y == 20);
+    ok = control_event_queue_take(&queue, &event);
+    assert(ok);
+    assert(event.mouse_event.action == AMOTION_EVENT_ACTION_UP);
+    assert(control_event_queue_is_empty(&queue));
+
+    control_event_queue_destroy(&queue);
+}
+
+static void test_control_event_queue_coalesce_scroll(void) {
+    struct control_event_queue queue;
+    SDL_bool init_ok = control_event_queue_init(&queue);
+    assert(init_ok);
+
+    SDL_bool ok;
+
+    struct control_event event = {
+        .type = CONTROL_EVENT_TYPE_SCROLL,
+        .scroll_event = {
+            .position = {
+                .point = {260, 1026},
+                .screen_size = {1080, 1920},
+            },
+            .hscroll = 1,
+            .vscroll = -1,
+        },
+    };
+    ok = control_event_queue_push(&queue, &event);
+    assert(ok);
+    ok = control_event_queue_push(&queue, &event);
+    assert(ok);
+    event.scroll_event.vscroll = -2;
+    ok = control_event_queue_push(&queue, &event);
+    assert(ok);
+
+    // at another position, not merged
+    event.scroll_event.position.point.x = 261;
+    ok = control_event_queue_push(&queue, &event);
+    assert(ok);
+
+    assert(queue.coalesced_count == 2);
+
+    ok = control_event_queue_take(&queue, &event);
+
+    assert(ok);
+    assert(event.scroll_event.hscroll == 3);
+    assert(event.scroll_event.vscroll == -4);
+    ok = control_event_queue_take(&queue, &event);
+    assert(ok);
+    assert(event.scroll_event.position.point.x == 261);
+    assert(event.scroll_event.hscroll == 1);
+    assert(event.scroll_event.vscroll == -2);
+    assert(control_event_queue_is_empty(&queue));
+
+    control_event_queue_destroy(&queue);
+}
+
+static void test_control_event_queue_reserved_slots(void) {
+    struct control_event_queue queue;
+    SDL_bool init_ok = control_event_queue_init(&queue);
+    assert(init_ok);
+
+    SDL_bool ok;
+
+    // alternate DOWN and MOVE, so that nothing is coalesced
+    int pushed = 0;
+    for (;;) {
+        enum android_motionevent_action action = pushed % 2
+                                               ? AMOTION_EVENT_ACTION_MOVE
+                                               : AMOTION_EVENT_ACTION_DOWN;
+        struct control_event event = mouse_event(action, pushed, pushed);
+        if (!control_event_queue_push(&queue, &event)) {
+            break;
+        }
+        ++pushed;
+    }
+    // rejected a move while the reserved slots are still available
+    assert(pushed % 2 == 1);
+    assert(!control_event_queue_is_full(&queue));
+
+    // button transitions may still be queued
+    struct control_event event = mouse_event(AMOTION_EVENT_ACTION_UP, 0, 0);
+    ok = control_event_queue_push(&queue, &event);
+    assert(ok);
+
+    control_event_queue_destroy(&queue);
+}
+
+static void test_control_event_queue_key_lane_priority(void) {
+    struct control_event_queue queue;
+    SDL_bool init_ok = control_event_queue_init(&queue);
+    assert(init_ok);
+
+    SDL_bool ok;
+
+    // alternate the buttons, so that the moves are not coalesced
+    struct control_event event = mouse_event(AMOTION_EVENT_ACTION_MOVE, 1, 1);
+    event.mouse_event.buttons = 0;
+    ok = control_event_queue_push(&queue, &event);
+    assert(ok);
+    event = mouse_event(AMOTION_EVENT_ACTION_MOVE, 2, 2);
+    ok = control_event_queue_push(&queue, &event);
+    assert(ok);
+    event = (struct control_event) {
+        .type = CONTROL_EVENT_TYPE_KEYCODE,
+        .keycode_event = {
+            .action = AKEY_EVENT_ACTION_DOWN,
+            .keycode = AKEYCODE_BACK,
+        },
+    };
+    ok = control_event_queue_push(&queue, &event);
+    assert(ok);
+
+    // the key event does not wait behind the mouse moves
+    ok = control_event_queue_take(&queue, &event);
+    assert(ok);
+    assert(event.type == CONTROL_EVENT_TYPE_KEYCODE);
+
+    // the mouse moves keep their order
+    ok = control_event_queue_take(&queue, &event);
+    assert(ok);
+    assert(event.mouse_event.position.point.x == 1);
+    ok = control_event_queue_take(&queue, &event);
+    assert(ok);
+    assert(event.mouse_event.position.point.x == 2);
+    assert(control_event_queue_is_empty(&queue));
+
+    control_event_queue_destroy(&queue);
+}
+
+static void test_control_event_queue_click_then_key(void) {
+    struct control_event_queue queue;
+    SDL_bool init_ok = control_event_queue_init(&queue);
+    assert(init_ok);
+
+    SDL_bool ok;
+
+    // click on a text field, then type immediately
+    struct control_event event = mouse_event(AMOTION_EVENT_ACTION_DOWN, 1, 1);
+    ok = control_event_queue_push(&queue, &event);
+    assert(ok);
+    event = mouse_event(AMOTION_EVENT_ACTION_MOVE, 2, 2);
+    ok = control_event_queue_push(&queue, &event);
+    assert(ok);
+    event = mouse_event(AMOTION_EVENT_ACTION_UP, 2, 2);
+    ok = control_event_queue_push(&queue, &event);
+    assert(ok);
+    event = (struct control_event) {
+        .type = CONTROL_EVENT_TYPE_TEXT,
+        .text_event = {
+            .text = "abc",
+        },
+    };
+    ok = control_event_queue_push(&queue, &event);
+    assert(ok);
+    // a move after the text may still be taken after it
+    event = mouse_event(AMOTION_EVENT_ACTION_MOVE, 3, 3);
+    event.mouse_event.buttons = 0;
+    ok = control_event_queue_push(&queue, &event);
+    assert(ok);
+
+    // the text waits for the click
+    ok = control_event_queue_take(&queue, &event);
+    assert(ok);
+    assert(event.mouse_event.action == AMOTION_EVENT_ACTION_DOWN);
+    ok = control_event_queue_take(&queue, &event);
+    assert(ok);
+    assert(event.mouse_event.action == AMOTION_EVENT_ACTION_MOVE);
+    ok = control_event_queue_take(&queue, &event);
+    assert(ok);
+    assert(event.mouse_event.action == AMOTION_EVENT_ACTION_UP);
+    ok = control_event_queue_take(&queue, &event);
+    assert(ok);
+    assert(event.type == CONTROL_EVENT_TYPE_TEXT);
+    assert(!strcmp(event.text_event.text, "abc"));
+    ok = control_event_queue_take(&queue, &event);
+    assert(ok);
+    assert(event.mouse_event.action == AMOTION_EVENT_ACTION_MOVE);
+    assert(event.mouse_event.position.point.x == 3);
+    assert(control_event_queue_is_empty(&queue));
+
+    control_event_queue_destroy(&queue);
+}
+
+static void test_control_event_queue_grow(void) {
+    struct control_event_queue queue;
+    SDL_bool init_ok = control_event_queue_init(&queue);
+    assert(init_ok);
+
+    SDL_bool ok;
+
+    // wrap the ring before growing, to check that the order is preserved
+    struct control_event event = {
+        .type = CONTROL_EVENT_TYPE_COMMAND,
+    };
+    for (int i = 0; i < CONTROL_EVENT_QUEUE_INITIAL_CAPACITY / 2; ++i) {
+        ok = control_event_queue_push(&queue, &event);
+        assert(ok);
+        ok = control_event_queue_take(&queue, &event);
+        assert(ok);
+    }
+
+    for (int i = 0; i < 10 * CONTROL_EVENT_QUEUE_INITIAL_CAPACITY; ++i) {
+        event.command_event.action = i;
+        ok = control_event_queue_push(&queue, &event);
+        assert(ok);
+    }
+    for (int i = 0; i < 10 * CONTROL_EVENT_QUEUE_INITIAL_CAPACITY; ++i) {
+        ok = control_event_queue_take(&queue, &event);
+        assert(ok);
+        assert(event.command_event.action == i);
+    }
+    assert(control_event_queue_is_empty(&queue));
+
+    control_event_queue_destroy(&queue);
+}
+
 int main(void) {
     test_control_event_queue_empty();
     test_control_event_queue_full();
     test_control_event_queue_push_take();
+    test_control_event_queue_coalesce_mouse_move();
+    test_control_event_queue_coalesce_scroll();
+    test_control_event_queue_reserved_slots();
+    test_control_event_queue_key_lane_priority();
+    test_control_event_queue_click_then_key();
+    test_control_event_queue_grow();
     return 0;
 }
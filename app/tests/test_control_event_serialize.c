@@ -132,10 +132,235 @@ static void test_serialize_scroll_event(void) {
     assert(!memcmp(buf, expected, sizeof(expected)));
 }
 
+static void test_serialize_video_event(void) {
+    struct control_event event = {
+        .type = CONTROL_EVENT_TYPE_VIDEO,
+        .video_event = {
+            .bit_rate = 4000000,
+            .max_size = 1024,
+            .frame_rate = 0,
+        },
+    };
+
+    unsigned char buf[SERIALIZED_EVENT_MAX_SIZE];
+    int size = control_event_serialize(&event, buf);
+    assert(size == 9);
+
+    const unsigned char expected[] = {
+        0x05, // CONTROL_EVENT_TYPE_VIDEO
+        0x00, 0x3d, 0x09, 0x00, // 4000000
+        0x04, 0x00, // 1024
+        0x00, 0x00, // unchanged
+    };
+    assert(!memcmp(buf, expected, sizeof(expected)));
+
+    struct control_event_serializer serializer;
+    control_event_serializer_init(&serializer, CONTROL_PROTOCOL_VERSION_2);
+    event.timestamp = 0;
+    size = control_event_serializer_write(&serializer, &event, buf);
+    assert(size == 9);
+
+    const unsigned char expected_v2[] = {
+        0x05, // CONTROL_EVENT_TYPE_VIDEO
+        0x00, // timestamp delta
+        0x80, 0x92, 0xf4, 0x01, // 4000000
+        0x80, 0x08, // 1024
+        0x00, // unchanged
+    };
+    assert(!memcmp(buf, expected_v2, sizeof(expected_v2)));
+}
+
+static void test_serialize_region_event(void) {
+    struct control_event event = {
+        .type = CONTROL_EVENT_TYPE_REGION,
+        .region_event = {
+            .position = {
+                .point = {
+                    .x = -270,
+                    .y = 480,
+                },
+                .screen_size = {
+                    .width = 1080,
+                    .height = 1920,
+                },
+            },
+            .width = 540,
+            .height = 960,
+        },
+    };
+
+    unsigned char buf[SERIALIZED_EVENT_MAX_SIZE];
+    int size = control_event_serialize(&event, buf);
+    assert(size == 17);
+
+    const unsigned char expected[] = {
+        0x06, // CONTROL_EVENT_TYPE_REGION
+        0xff, 0xff, 0xfe, 0xf2, // -270
+        0x00, 0x00, 0x01, 0xe0, // 480
+        0x04, 0x38, 0x07, 0x80, // 1080 1920
+        0x02, 0x1c, // 540
+        0x03, 0xc0, // 960
+    };
+    assert(!memcmp(buf, expected, sizeof(expected)));
+
+    struct control_event_serializer serializer;
+    control_event_serializer_init(&serializer, CONTROL_PROTOCOL_VERSION_2);
+    event.timestamp = 0;
+    size = control_event_serializer_write(&serializer, &event, buf);
+    assert(size == 14);
+
+    const unsigned char expected_v2[] = {
+        0x16, // CONTROL_EVENT_TYPE_REGION | CONTROL_EVENT_V2_FLAG_SCREEN_SIZE
+        0x00, // timestamp delta
+        0xb8, 0x08, 0x80, 0x0f, // 1080 1920
+        0x9b, 0x04, // -270
+        0xc0, 0x07, // 480
+        0x9c, 0x04, // 540
+        0xc0, 0x07, // 960
+    };
+    assert(!memcmp(buf, expected_v2, sizeof(expected_v2)));
+}
+
+static void test_serialize_v2_events(void) {
+    struct control_event_serializer serializer;
+    control_event_serializer_init(&serializer, CONTROL_PROTOCOL_VERSION_2);
+
+    unsigned char buf[4 * SERIALIZED_EVENT_MAX_SIZE];
+    int size = 0;
+
+    struct control_event event = {
+        .type = CONTROL_EVENT_TYPE_MOUSE,
+        .timestamp = 1000,
+        .mouse_event = {
+            .action = AMOTION_EVENT_ACTION_DOWN,
+            .buttons = AMOTION_EVENT_BUTTON_PRIMARY,
+            .position = {
+                .point = {
+                    .x = 260,
+                    .y = 1026,
+                },
+                .screen_size = {
+                    .width = 1080,
+                    .height = 1920,
+                },
+            },
+        },
+    };
+    size += control_event_serializer_write(&serializer, &event, &buf[size]);
+
+    event.timestamp = 1016;
+    event.mouse_event.action = AMOTION_EVENT_ACTION_MOVE;
+    event.mouse_event.position.point.x = 258;
+    event.mouse_event.position.point.y = 1030;
+    size += control_event_serializer_write(&serializer, &event, &buf[size]);
+
+    // sent after the move, but generated before
+    event = (struct control_event) {
+        .type = CONTROL_EVENT_TYPE_KEYCODE,
+        .timestamp = 1010,
+        .keycode_event = {
+            .action = AKEY_EVENT_ACTION_DOWN,
+            .keycode = AKEYCODE_ENTER,
+            .metastate = 0,
+        },
+    };
+    size += control_event_serializer_write(&serializer, &event, &buf[size]);
+
+    event = (struct control_event) {
+        .type = CONTROL_EVENT_TYPE_TEXT,
+        .timestamp = 1010,
+        .text_event = {
+            .text = "hi",
+        },
+    };
+    size += control_event_serializer_write(&serializer, &event, &buf[size]);
+
+    const unsigned char expected[] = {
+        // mouse down
+        0x12, // CONTROL_EVENT_TYPE_MOUSE | CONTROL_EVENT_V2_FLAG_SCREEN_SIZE
+        0xd0, 0x0f, // timestamp delta +1000
+        0x00, // AMOTION_EVENT_ACTION_DOWN
+        0x01, // AMOTION_EVENT_BUTTON_PRIMARY
+        0xb8, 0x08, 0x80, 0x0f, // 1080 1920
+        0x88, 0x04, 0x84, 0x10, // +260 +1026
+        // mouse move, same screen size
+        0x02, // CONTROL_EVENT_TYPE_MOUSE
+        0x20, // timestamp delta +16
+        0x02, // AMOTION_EVENT_ACTION_MOVE
+        0x01, // AMOTION_EVENT_BUTTON_PRIMARY
+        0x03, 0x08, // -2 +4
+        // keycode
+        0x00, // CONTROL_EVENT_TYPE_KEYCODE
+        0x0b, // timestamp delta -6
+        0x00, // AKEY_EVENT_ACTION_DOWN
+        0x42, // AKEYCODE_ENTER
+        0x00, // metastate
+        // text
+        0x01, // CONTROL_EVENT_TYPE_TEXT
+        0x00, // timestamp delta 0
+        0x02, // text length
+        'h', 'i',
+    };
+    assert(size == sizeof(expected));
+    assert(!memcmp(buf, expected, sizeof(expected)));
+}
+
+static void test_serialize_v2_scroll_screen_size_change(void) {
+    struct control_event_serializer serializer;
+    control_event_serializer_init(&serializer, CONTROL_PROTOCOL_VERSION_2);
+
+    struct control_event event = {
+        .type = CONTROL_EVENT_TYPE_SCROLL,
+        .timestamp = 0,
+        .scroll_event = {
+            .position = {
+                .point = {
+                    .x = 0,
+                    .y = 0,
+                },
+                .screen_size = {
+                    .width = 1080,
+                    .height = 1920,
+                },
+            },
+            .hscroll = 1,
+            .vscroll = -1,
+        },
+    };
+
+    unsigned char buf[SERIALIZED_EVENT_MAX_SIZE];
+    int size = control_event_serializer_write(&serializer, &event, buf);
+    assert(size == 10);
+
+    // rotated
+    event.scroll_event.position.screen_size.width = 1920;
+    event.scroll_event.position.screen_size.height = 1080;
+    size = control_event_serializer_write(&serializer, &event, buf);
+    assert(size == 10);
+
+    const unsigned char expected[] = {
+        0x13, // CONTROL_EVENT_TYPE_SCROLL | CONTROL_EVENT_V2_FLAG_SCREEN_SIZE
+        0x00, // timestamp delta 0
+        0x80, 0x0f, 0xb8, 0x08, // 1920 1080
+        0x00, 0x00, // +0 +0
+        0x02, 0x01, // 1 -1
+    };
+    assert(!memcmp(buf, expected, sizeof(expected)));
+
+    // same screen size, not sent again
+    size = control_event_serializer_write(&serializer, &event, buf);
+    assert(size == 6);
+    assert(buf[0] == CONTROL_EVENT_TYPE_SCROLL);
+}
+
 int main(void) {
     test_serialize_keycode_event();
     test_serialize_text_event();
     test_serialize_long_text_event();
     test_serialize_mouse_event();
     test_serialize_scroll_event();
+    test_serialize_video_event();
+    test_serialize_region_event();
+    test_serialize_v2_events();
+    test_serialize_v2_scroll_screen_size_change();
 }
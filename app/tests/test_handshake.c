@@ -0,0 +1,192 @@
+#include <assert.h>
+#include <string.h>
+
+#include "handshake.h"
+
+static void test_serialize_options(void) {
+    struct handshake_options options = {
+        .max_size = 1024,
+        .bit_rate = 8000000,
+        .crop = "100:200:10:20",
+        .send_frame_meta = SDL_TRUE,
+        .control_protocol_version = 2,
+        .square_video = SDL_FALSE,
+        .codec = DEVICE_CODEC_H265,
+    };
+
+    unsigned char buf[HANDSHAKE_MAX_OPTIONS_LENGTH];
+    size_t size = handshake_serialize_options(&options, buf);
+    assert(size == 47);
+
+    const unsigned char expected[] = {
+        0x01, 0x00, 0x2C, // version 1, payload length 44
+        0x01, 0x00, 0x02, 0x04, 0x00, // max size: 1024
+        0x02, 0x00, 0x04, 0x00, 0x7A, 0x12, 0x00, // bit rate: 8000000
+        0x03, 0x00, 0x0D, '1', '0', '0', ':', '2', '0', '0', ':', '1', '0',
+                          ':', '2', '0', // crop
+        0x04, 0x00, 0x01, 0x01, // send frame meta
+        0x05, 0x00, 0x01, 0x02, // control protocol version 2
+        0x06, 0x00, 0x01, 0x00, // no square video
+        0x07, 0x00, 0x01, 0x01, // codec: H.265
+    };
+    assert(!memcmp(buf, expected, sizeof(expected)));
+}
+
+static void test_serialize_options_no_crop(void) {
+    struct handshake_options options = {
+        .max_size = 0,
+        .bit_rate = 8000000,
+        .crop = NULL,
+        .send_frame_meta = SDL_FALSE,
+        .control_protocol_version = 2,
+        .square_video = SDL_TRUE,
+        .codec = DEVICE_CODEC_H264,
+    };
+
+    unsigned char buf[HANDSHAKE_MAX_OPTIONS_LENGTH];
+    size_t size = handshake_serialize_options(&options, buf);
+    assert(size == 31);
+
+    const unsigned char expected[] = {
+        0x01, 0x00, 0x1C, // version 1, payload length 28
+        0x01, 0x00, 0x02, 0x00, 0x00, // max size: 0
+        0x02, 0x00, 0x04, 0x00, 0x7A, 0x12, 0x00, // bit rate: 8000000
+        0x04, 0x00, 0x01, 0x00, // no frame meta
+        0x05, 0x00, 0x01, 0x02, // control protocol version 2
+        0x06, 0x00, 0x01, 0x01, // square video
+        0x07, 0x00, 0x01, 0x00, // codec: H.264
+    };
+    assert(!memcmp(buf, expected, sizeof(expected)));
+}
+
+static void test_parse_header(void) {
+    const unsigned char buf[] = {0x01, 0x01, 0x02};
+    Uint16 len;
+    assert(handshake_parse_header(buf, &len));
+    assert(len == 258);
+}
+
+static void test_parse_header_more_recent_version(void) {
+    // a more recent version only adds entries
+    const unsigned char buf[] = {0x02, 0x00, 0x10};
+    Uint16 len;
+    assert(handshake_parse_header(buf, &len));
+    assert(len == 16);
+}
+
+static void test_parse_header_invalid(void) {
+    Uint16 len;
+
+    const unsigned char invalid_version[] = {0x00, 0x00, 0x10};
+    assert(!handshake_parse_header(invalid_version, &len));
+
+    const unsigned char too_long[] = {0x01, 0xFF, 0xFF};
+    assert(!handshake_parse_header(too_long, &len));
+}
+
+static void test_parse_device_info(void) {
+    const unsigned char payload[] = {
+        0x01, 0x00, 0x07, 'P', 'i', 'x', 'e', 'l', ' ', '3', // device name
+        0x02, 0x00, 0x04, 0x04, 0x38, 0x08, 0x70, // video size: 1080x2160
+        0x03, 0x00, 0x01, 0x01, // codec: H.265
+        0x04, 0x00, 0x01, 0x02, // control protocol version 2
+        0x05, 0x00, 0x04, 0x00, 0x00, 0x00, 0x07, // capabilities
+    };
+
+    struct device_info info;
+    assert(handshake_parse_device_info(payload, sizeof(payload), &info));
+    assert(!strcmp(info.device_name, "Pixel 3"));
+    assert(info.frame_size.width == 1080);
+    assert(info.frame_size.height == 2160);
+    assert(info.codec == DEVICE_CODEC_H265);
+    assert(info.control_protocol_version == 2);
+    assert(info.capabilities == (HANDSHAKE_CAPABILITY_H265_ENCODER
+                               | HANDSHAKE_CAPABILITY_REGION
+                               | HANDSHAKE_CAPABILITY_PAUSE_VIDEO));
+}
+
+static void test_parse_device_info_defaults(void) {
+    // as sent by an older server, which does not know the recent entries
+    const unsigned char payload[] = {
+        0x02, 0x00, 0x04, 0x04, 0x38, 0x08, 0x70, // video size: 1080x2160
+        0x2A, 0x00, 0x03, 0x01, 0x02, 0x03, // unknown entry, to be skipped
+    };
+
+    struct device_info info;
+    assert(handshake_parse_device_info(payload, sizeof(payload), &info));
+    assert(!strcmp(info.device_name, ""));
+    assert(info.frame_size.width == 1080);
+    assert(info.frame_size.height == 2160);
+    assert(info.codec == DEVICE_CODEC_H264);
+    assert(info.control_protocol_version == 1);
+    assert(info.capabilities == 0);
+}
+
+static void test_parse_device_info_long_name(void) {
+    unsigned char payload[3 + 100 + 7];
+    payload[0] = 0x01;
+    payload[1] = 0x00;
+    payload[2] = 100;
+    memset(&payload[3], 'a', 100);
+    const unsigned char size_entry[] = {0x02, 0x00, 0x04, 0x00, 0x10, 0x00, 0x20};
+    memcpy(&payload[103], size_entry, sizeof(size_entry));
+
+    struct device_info info;
+    assert(handshake_parse_device_info(payload, sizeof(payload), &info));
+    // truncated
+    assert(strlen(info.device_name) == DEVICE_NAME_FIELD_LENGTH - 1);
+    assert(info.frame_size.width == 16);
+    assert(info.frame_size.height == 32);
+}
+
+static void test_parse_device_info_invalid(void) {
+    struct device_info info;
+
+    // the value is truncated
+    const unsigned char truncated[] = {
+        0x02, 0x00, 0x04, 0x04, 0x38, 0x08,
+    };
+    assert(!handshake_parse_device_info(truncated, sizeof(truncated), &info));
+
+    // the entry header is truncated
+    const unsigned char truncated_header[] = {
+        0x02, 0x00, 0x04, 0x04, 0x38, 0x08, 0x70,
+        0x03, 0x00,
+    };
+    assert(!handshake_parse_device_info(truncated_header,
+                                        sizeof(truncated_header), &info));
+
+    // wrong length for a known entry
+    const unsigned char wrong_length[] = {
+        0x02, 0x00, 0x03, 0x04, 0x38, 0x08,
+    };
+    assert(!handshake_parse_device_info(wrong_length, sizeof(wrong_length),
+                                        &info));
+
+    // unknown codec
+    const unsigned char unknown_codec[] = {
+        0x02, 0x00, 0x04, 0x04, 0x38, 0x08, 0x70,
+        0x03, 0x00, 0x01, 0x09,
+    };
+    assert(!handshake_parse_device_info(unknown_codec, sizeof(unknown_codec),
+                                        &info));
+
+    // no video size
+    const unsigned char no_size[] = {
+        0x03, 0x00, 0x01, 0x00,
+    };
+    assert(!handshake_parse_device_info(no_size, sizeof(no_size), &info));
+}
+
+int main(void) {
+    test_serialize_options();
+    test_serialize_options_no_crop();
+    test_parse_header();
+    test_parse_header_more_recent_version();
+    test_parse_header_invalid();
+    test_parse_device_info();
+    test_parse_device_info_defaults();
+    test_parse_device_info_long_name();
+    test_parse_device_info_invalid();
+    return 0;
+}
@@ -126,6 +126,72 @@ static void test_xstrjoin_truncated_after_sep(void) {
     assert(!strcmp("abc de ", s));
 }
 
+static void test_utf8_truncate(void) {
+    const char *s = "aÉbÔc";
+    assert(strlen(s) == 7); // É and Ô are 2 bytes-wide
+
+    size_t count;
+
+    count = utf8_truncation_index(s, 1);
+    assert(count == 1);
+
+    count = utf8_truncation_index(s, 2);
+    assert(count == 1); // É is 2 bytes-wide
+
+    count = utf8_truncation_index(s, 3);
+    assert(count == 3);
+
+    count = utf8_truncation_index(s, 4);
+    assert(count == 4);
+
+    count = utf8_truncation_index(s, 5);
+    assert(count == 4); // Ô is 2 bytes-wide
+
+    count = utf8_truncation_index(s, 6);
+    assert(count == 6);
+
+    count = utf8_truncation_index(s, 7);
+    assert(count == 7);
+
+    count = utf8_truncation_index(s, 8);
+    assert(count == 7); // no more chars
+}
+
+static void test_utf8_truncate_chunks(void) {
+    // split a long text into chunks, as the controller does for text events,
+    // with a 2-byte char across each chunk limit
+    enum { ROOM = 300, CHUNKS = 4 };
+    char s[CHUNKS * ROOM + 1];
+    memset(s, 'a', sizeof(s) - 1);
+    s[sizeof(s) - 1] = '\0';
+    for (int i = 1; i < CHUNKS; ++i) {
+        // "é" is "\xc3\xa9"
+        s[i * ROOM - 1] = '\xc3';
+        s[i * ROOM] = '\xa9';
+    }
+
+    char joined[sizeof(s)];
+    size_t joined_len = 0;
+    const char *text = s;
+    int chunks = 0;
+    while (*text) {
+        size_t n = utf8_truncation_index(text, ROOM);
+        assert(n);
+        assert(n <= ROOM);
+        // never split inside a char
+        assert((text[n] & 0xc0) != 0x80);
+        memcpy(&joined[joined_len], text, n);
+        joined_len += n;
+        text += n;
+        ++chunks;
+    }
+    joined[joined_len] = '\0';
+
+    // the first chunk stops before "é", the next ones start with it
+    assert(chunks == CHUNKS + 1);
+    assert(!strcmp(s, joined));
+}
+
 int main(void) {
     test_xstrncpy_simple();
     test_xstrncpy_just_fit();
@@ -135,5 +201,7 @@ int main(void) {
     test_xstrjoin_truncated_in_token();
     test_xstrjoin_truncated_before_sep();
     test_xstrjoin_truncated_after_sep();
+    test_utf8_truncate();
+    test_utf8_truncate_chunks();
     return 0;
 }
@@ -10,8 +10,12 @@ public final class ControlEvent {
     public static final int TYPE_MOUSE = 2;
     public static final int TYPE_SCROLL = 3;
     public static final int TYPE_COMMAND = 4;
+    public static final int TYPE_VIDEO = 5;
+    public static final int TYPE_REGION = 6;
 
     public static final int COMMAND_BACK_OR_SCREEN_ON = 0;
+    public static final int COMMAND_PAUSE_VIDEO = 1;
+    public static final int COMMAND_RESUME_VIDEO = 2;
 
     private int type;
     private String text;
@@ -22,29 +26,36 @@ public final class ControlEvent {
     private Position position;
     private int hScroll;
     private int vScroll;
-
-    private ControlEvent() {
+    // video settings, 0 to keep the current value
+    private int bitRate;
+    private int maxSize;
+    private int frameRate;
+    // region to capture (at position), 0 to restore the initial crop
+    private int width;
+    private int height;
+    private long timestamp; // client time in ms, only received with protocol v2
+
+    // the position of the reused instance (see ControlEventReader)
+    private final Position reusablePosition = new Position(0, 0, null);
+
+    ControlEvent() {
     }
 
     public static ControlEvent createKeycodeControlEvent(int action, int keycode, int metaState) {
         ControlEvent event = new ControlEvent();
-        event.type = TYPE_KEYCODE;
-        event.action = action;
-        event.keycode = keycode;
-        event.metaState = metaState;
+        event.setKeycodeControlEvent(action, keycode, metaState);
         return event;
     }
 
     public static ControlEvent createTextControlEvent(String text) {
         ControlEvent event = new ControlEvent();
-        event.type = TYPE_TEXT;
-        event.text = text;
+        event.setTextControlEvent(text);
         return event;
     }
 
     public static ControlEvent createMotionControlEvent(int action, int buttons, Position position) {
         ControlEvent event = new ControlEvent();
-        event.type = TYPE_MOUSE;
+        event.reset(TYPE_MOUSE);
         event.action = action;
         event.buttons = buttons;
         event.position = position;
@@ -53,7 +64,7 @@ public final class ControlEvent {
 
     public static ControlEvent createScrollControlEvent(Position position, int hScroll, int vScroll) {
         ControlEvent event = new ControlEvent();
-        event.type = TYPE_SCROLL;
+        event.reset(TYPE_SCROLL);
         event.position = position;
         event.hScroll = hScroll;
         event.vScroll = vScroll;
@@ -62,11 +73,93 @@ public final class ControlEvent {
 
     public static ControlEvent createCommandControlEvent(int action) {
         ControlEvent event = new ControlEvent();
-        event.type = TYPE_COMMAND;
-        event.action = action;
+        event.setCommandControlEvent(action);
         return event;
     }
 
+    public static ControlEvent createVideoControlEvent(int bitRate, int maxSize, int frameRate) {
+        ControlEvent event = new ControlEvent();
+        event.setVideoControlEvent(bitRate, maxSize, frameRate);
+        return event;
+    }
+
+    public static ControlEvent createRegionControlEvent(Position position, int width, int height) {
+        ControlEvent event = new ControlEvent();
+        event.reset(TYPE_REGION);
+        event.position = position;
+        event.width = width;
+        event.height = height;
+        return event;
+    }
+
+    // The following methods overwrite the instance, so that the reader does not allocate for every event.
+
+    private void reset(int newType) {
+        type = newType;
+        text = null;
+        metaState = 0;
+        action = 0;
+        keycode = 0;
+        buttons = 0;
+        position = null;
+        hScroll = 0;
+        vScroll = 0;
+        bitRate = 0;
+        maxSize = 0;
+        frameRate = 0;
+        width = 0;
+        height = 0;
+        timestamp = 0;
+    }
+
+    void setKeycodeControlEvent(int newAction, int newKeycode, int newMetaState) {
+        reset(TYPE_KEYCODE);
+        action = newAction;
+        keycode = newKeycode;
+        metaState = newMetaState;
+    }
+
+    void setTextControlEvent(String newText) {
+        reset(TYPE_TEXT);
+        text = newText;
+    }
+
+    void setMotionControlEvent(int newAction, int newButtons, int x, int y, Size screenSize) {
+        reset(TYPE_MOUSE);
+        action = newAction;
+        buttons = newButtons;
+        reusablePosition.set(x, y, screenSize);
+        position = reusablePosition;
+    }
+
+    void setScrollControlEvent(int x, int y, Size screenSize, int newHScroll, int newVScroll) {
+        reset(TYPE_SCROLL);
+        reusablePosition.set(x, y, screenSize);
+        position = reusablePosition;
+        hScroll = newHScroll;
+        vScroll = newVScroll;
+    }
+
+    void setCommandControlEvent(int newAction) {
+        reset(TYPE_COMMAND);
+        action = newAction;
+    }
+
+    void setVideoControlEvent(int newBitRate, int newMaxSize, int newFrameRate) {
+        reset(TYPE_VIDEO);
+        bitRate = newBitRate;
+        maxSize = newMaxSize;
+        frameRate = newFrameRate;
+    }
+
+    void setRegionControlEvent(int x, int y, Size screenSize, int newWidth, int newHeight) {
+        reset(TYPE_REGION);
+        reusablePosition.set(x, y, screenSize);
+        position = reusablePosition;
+        width = newWidth;
+        height = newHeight;
+    }
+
     public int getType() {
         return type;
     }
@@ -102,4 +195,32 @@ public final class ControlEvent {
     public int getVScroll() {
         return vScroll;
     }
+
+    public int getBitRate() {
+        return bitRate;
+    }
+
+    public int getMaxSize() {
+        return maxSize;
+    }
+
+    public int getFrameRate() {
+        return frameRate;
+    }
+
+    public int getWidth() {
+        return width;
+    }
+
+    public int getHeight() {
+        return height;
+    }
+
+    public long getTimestamp() {
+        return timestamp;
+    }
+
+    void setTimestamp(long timestamp) {
+        this.timestamp = timestamp;
+    }
 }
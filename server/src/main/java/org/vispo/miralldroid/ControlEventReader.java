@@ -3,6 +3,7 @@ package org.vispo.miralldroid;
 import java.io.EOFException;
 import java.io.IOException;
 import java.io.InputStream;
+import java.nio.BufferUnderflowException;
 import java.nio.ByteBuffer;
 import java.nio.charset.StandardCharsets;
 
@@ -12,15 +13,43 @@ public class ControlEventReader {
     private static final int MOUSE_PAYLOAD_LENGTH = 17;
     private static final int SCROLL_PAYLOAD_LENGTH = 20;
     private static final int COMMAND_PAYLOAD_LENGTH = 1;
+    private static final int VIDEO_PAYLOAD_LENGTH = 8;
+    private static final int REGION_PAYLOAD_LENGTH = 16;
 
     public static final int TEXT_MAX_LENGTH = 300;
     private static final int RAW_BUFFER_SIZE = 1024;
 
+    public static final int PROTOCOL_VERSION_1 = 1;
+    public static final int PROTOCOL_VERSION_2 = 2;
+
+    // v2 header flag, set when the screen size follows
+    private static final int V2_FLAG_SCREEN_SIZE = 0x10;
+    private static final int V2_TYPE_MASK = 0x0f;
+
     private final byte[] rawBuffer = new byte[RAW_BUFFER_SIZE];
     private final ByteBuffer buffer = ByteBuffer.wrap(rawBuffer);
     private final byte[] textBuffer = new byte[TEXT_MAX_LENGTH];
 
+    private final int version;
+
+    // the returned event is reused, it is only valid until the next call to next()
+    private final ControlEvent event = new ControlEvent();
+
+    // v2 state, the values are relative to the previous event
+    private int lastX;
+    private int lastY;
+    private Size screenSize = new Size(0, 0); // also cached in v1, to avoid an allocation per event
+    private long lastTimestamp;
+
     public ControlEventReader() {
+        this(PROTOCOL_VERSION_1);
+    }
+
+    public ControlEventReader(int version) {
+        if (version != PROTOCOL_VERSION_1 && version != PROTOCOL_VERSION_2) {
+            throw new IllegalArgumentException("Unsupported control protocol version: " + version);
+        }
+        this.version = version;
         // invariant: the buffer is always in "get" mode
         buffer.limit(0);
     }
@@ -43,7 +72,18 @@ public class ControlEventReader {
         buffer.flip();
     }
 
+    /**
+     * Parse the next event from the buffer.
+     * <p>
+     * To avoid allocations on the hot path, the same instance is returned every time: it must not be kept after the next
+     * call to {@code next()}.
+     *
+     * @return the next event, or {@code null} if no complete event is available
+     */
     public ControlEvent next() {
+        if (version == PROTOCOL_VERSION_2) {
+            return nextV2();
+        }
         if (!buffer.hasRemaining()) {
             return null;
         }
@@ -67,6 +107,12 @@ public class ControlEventReader {
             case ControlEvent.TYPE_COMMAND:
                 controlEvent = parseCommandControlEvent();
                 break;
+            case ControlEvent.TYPE_VIDEO:
+                controlEvent = parseVideoControlEvent();
+                break;
+            case ControlEvent.TYPE_REGION:
+                controlEvent = parseRegionControlEvent();
+                break;
             default:
                 Ln.w("Unknown event type: " + type);
                 controlEvent = null;
@@ -87,11 +133,12 @@ public class ControlEventReader {
         int action = toUnsigned(buffer.get());
         int keycode = buffer.getInt();
         int metaState = buffer.getInt();
-        return ControlEvent.createKeycodeControlEvent(action, keycode, metaState);
+        event.setKeycodeControlEvent(action, keycode, metaState);
+        return event;
     }
 
     private ControlEvent parseTextControlEvent() {
-        if (buffer.remaining() < 1) {
+        if (buffer.remaining() < 2) {
             return null;
         }
         int len = toUnsigned(buffer.getShort());
@@ -100,7 +147,8 @@ public class ControlEventReader {
         }
         buffer.get(textBuffer, 0, len);
         String text = new String(textBuffer, 0, len, StandardCharsets.UTF_8);
-        return ControlEvent.createTextControlEvent(text);
+        event.setTextControlEvent(text);
+        return event;
     }
 
     private ControlEvent parseMouseControlEvent() {
@@ -109,18 +157,24 @@ public class ControlEventReader {
         }
         int action = toUnsigned(buffer.get());
         int buttons = buffer.getInt();
-        Position position = readPosition(buffer);
-        return ControlEvent.createMotionControlEvent(action, buttons, position);
+        int x = buffer.getInt();
+        int y = buffer.getInt();
+        Size size = readScreenSize();
+        event.setMotionControlEvent(action, buttons, x, y, size);
+        return event;
     }
 
     private ControlEvent parseScrollControlEvent() {
         if (buffer.remaining() < SCROLL_PAYLOAD_LENGTH) {
             return null;
         }
-        Position position = readPosition(buffer);
+        int x = buffer.getInt();
+        int y = buffer.getInt();
+        Size size = readScreenSize();
         int hScroll = buffer.getInt();
         int vScroll = buffer.getInt();
-        return ControlEvent.createScrollControlEvent(position, hScroll, vScroll);
+        event.setScrollControlEvent(x, y, size, hScroll, vScroll);
+        return event;
     }
 
     private ControlEvent parseCommandControlEvent() {
@@ -128,15 +182,170 @@ public class ControlEventReader {
             return null;
         }
         int action = toUnsigned(buffer.get());
-        return ControlEvent.createCommandControlEvent(action);
+        event.setCommandControlEvent(action);
+        return event;
     }
 
-    private static Position readPosition(ByteBuffer buffer) {
+    private ControlEvent parseVideoControlEvent() {
+        if (buffer.remaining() < VIDEO_PAYLOAD_LENGTH) {
+            return null;
+        }
+        int bitRate = buffer.getInt();
+        int maxSize = toUnsigned(buffer.getShort());
+        int frameRate = toUnsigned(buffer.getShort());
+        event.setVideoControlEvent(bitRate, maxSize, frameRate);
+        return event;
+    }
+
+    private ControlEvent parseRegionControlEvent() {
+        if (buffer.remaining() < REGION_PAYLOAD_LENGTH) {
+            return null;
+        }
         int x = buffer.getInt();
         int y = buffer.getInt();
+        Size size = readScreenSize();
+        int width = toUnsigned(buffer.getShort());
+        int height = toUnsigned(buffer.getShort());
+        event.setRegionControlEvent(x, y, size, width, height);
+        return event;
+    }
+
+    private ControlEvent nextV2() {
+        if (!buffer.hasRemaining()) {
+            return null;
+        }
+        int savedPosition = buffer.position();
+        try {
+            ControlEvent controlEvent = parseV2();
+            if (controlEvent == null) {
+                // unknown type, the stream cannot be resynchronized
+                buffer.position(savedPosition);
+            }
+            return controlEvent;
+        } catch (BufferUnderflowException e) {
+            // the event is not complete, the state has not been updated
+            buffer.position(savedPosition);
+            return null;
+        }
+    }
+
+    // the state is only updated once the whole event is read
+    private ControlEvent parseV2() {
+        int header = toUnsigned(buffer.get());
+        int type = header & V2_TYPE_MASK;
+        long timestamp = lastTimestamp + readVarint(buffer);
+        switch (type) {
+            case ControlEvent.TYPE_KEYCODE: {
+                int action = toUnsigned(buffer.get());
+                int keycode = readUVarint(buffer);
+                int metaState = readUVarint(buffer);
+                event.setKeycodeControlEvent(action, keycode, metaState);
+                break;
+            }
+            case ControlEvent.TYPE_TEXT: {
+                int len = readUVarint(buffer);
+                if (len > TEXT_MAX_LENGTH) {
+                    Ln.w("Text too long: " + len);
+                    return null;
+                }
+                buffer.get(textBuffer, 0, len);
+                String text = new String(textBuffer, 0, len, StandardCharsets.UTF_8);
+                event.setTextControlEvent(text);
+                break;
+            }
+            case ControlEvent.TYPE_MOUSE: {
+                int action = toUnsigned(buffer.get());
+                int buttons = readUVarint(buffer);
+                Size size = readScreenSizeV2(header);
+                int x = lastX + readVarint(buffer);
+                int y = lastY + readVarint(buffer);
+                event.setMotionControlEvent(action, buttons, x, y, size);
+                break;
+            }
+            case ControlEvent.TYPE_SCROLL: {
+                Size size = readScreenSizeV2(header);
+                int x = lastX + readVarint(buffer);
+                int y = lastY + readVarint(buffer);
+                int hScroll = readVarint(buffer);
+                int vScroll = readVarint(buffer);
+                event.setScrollControlEvent(x, y, size, hScroll, vScroll);
+                break;
+            }
+            case ControlEvent.TYPE_COMMAND: {
+                int action = toUnsigned(buffer.get());
+                event.setCommandControlEvent(action);
+                break;
+            }
+            case ControlEvent.TYPE_VIDEO: {
+                int bitRate = readUVarint(buffer);
+                int maxSize = readUVarint(buffer);
+                int frameRate = readUVarint(buffer);
+                event.setVideoControlEvent(bitRate, maxSize, frameRate);
+                break;
+            }
+            case ControlEvent.TYPE_REGION: {
+                Size size = readScreenSizeV2(header);
+                int x = lastX + readVarint(buffer);
+                int y = lastY + readVarint(buffer);
+                int width = readUVarint(buffer);
+                int height = readUVarint(buffer);
+                event.setRegionControlEvent(x, y, size, width, height);
+                break;
+            }
+            default:
+                Ln.w("Unknown event type: " + type);
+                return null;
+        }
+
+        // the event is complete, commit the state
+        lastTimestamp = timestamp;
+        Position position = event.getPosition();
+        if (position != null) {
+            lastX = position.getX();
+            lastY = position.getY();
+            screenSize = position.getScreenSize();
+        }
+        event.setTimestamp(timestamp);
+        return event;
+    }
+
+    private Size readScreenSizeV2(int header) {
+        if ((header & V2_FLAG_SCREEN_SIZE) == 0) {
+            return screenSize;
+        }
+        int screenWidth = readUVarint(buffer);
+        int screenHeight = readUVarint(buffer);
+        return new Size(screenWidth, screenHeight);
+    }
+
+    // read an unsigned LEB128 value (at most 5 bytes for 32 bits)
+    @SuppressWarnings("checkstyle:MagicNumber")
+    private static int readUVarint(ByteBuffer buffer) {
+        int value = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            int b = toUnsigned(buffer.get());
+            value |= (b & 0x7f) << shift;
+            if ((b & 0x80) == 0) {
+                return value;
+            }
+        }
+        throw new IllegalStateException("Malformed varint");
+    }
+
+    // read a zigzag-encoded value
+    private static int readVarint(ByteBuffer buffer) {
+        int zigzag = readUVarint(buffer);
+        return (zigzag >>> 1) ^ -(zigzag & 1);
+    }
+
+    // v1 sends the screen size with every position, only allocate when it changes
+    private Size readScreenSize() {
         int screenWidth = toUnsigned(buffer.getShort());
         int screenHeight = toUnsigned(buffer.getShort());
-        return new Position(x, y, screenWidth, screenHeight);
+        if (screenSize.getWidth() != screenWidth || screenSize.getHeight() != screenHeight) {
+            screenSize = new Size(screenWidth, screenHeight);
+        }
+        return screenSize;
     }
 
     @SuppressWarnings("checkstyle:MagicNumber")
@@ -8,26 +8,36 @@ import java.io.Closeable;
 import java.io.FileDescriptor;
 import java.io.IOException;
 import java.io.InputStream;
-import java.nio.charset.StandardCharsets;
 
 import org.vispo.miralldroid.Device;
 
 public final class DesktopConnection implements Closeable {
 
-    private static final int DEVICE_NAME_FIELD_LENGTH = 64;
-
     private static final String SOCKET_NAME = "miralldroid";
 
-    private final LocalSocket socket;
-    private final InputStream inputStream;
-    private final FileDescriptor fd;
-
-    private final ControlEventReader reader = new ControlEventReader();
-
-    private DesktopConnection(LocalSocket socket) throws IOException {
-        this.socket = socket;
-        inputStream = socket.getInputStream();
-        fd = socket.getFileDescriptor();
+    // the first byte sent on each socket, so that the client knows which is which
+    private static final int SOCKET_TYPE_VIDEO = 0;
+    private static final int SOCKET_TYPE_CONTROL = 1;
+
+    private final LocalSocket videoSocket;
+    private final FileDescriptor videoFd;
+    private final LocalSocket controlSocket;
+    private final InputStream controlInputStream;
+
+    private final ControlEventReader reader;
+    private final int controlProtocolVersion;
+    // the version of the server hello, or 0 to send the device info in the legacy format
+    private final int handshakeVersion;
+
+    private DesktopConnection(LocalSocket videoSocket, LocalSocket controlSocket, int controlProtocolVersion, int handshakeVersion)
+            throws IOException {
+        reader = new ControlEventReader(controlProtocolVersion);
+        this.controlProtocolVersion = controlProtocolVersion;
+        this.handshakeVersion = handshakeVersion;
+        this.videoSocket = videoSocket;
+        this.controlSocket = controlSocket;
+        videoFd = videoSocket.getFileDescriptor();
+        controlInputStream = controlSocket.getInputStream();
     }
 
     private static LocalSocket connect(String abstractName) throws IOException {
@@ -36,63 +46,120 @@ public final class DesktopConnection implements Closeable {
         return localSocket;
     }
 
-    private static LocalSocket listenAndAccept(String abstractName) throws IOException {
-        LocalServerSocket localServerSocket = new LocalServerSocket(abstractName);
+    /**
+     * Open the connection to the client.
+     * <p>
+     * If {@code handshake} is {@code true}, the options (except the tunnel mode) are read from the client hello. Otherwise, the client
+     * does not support the handshake: as in the legacy protocol, a single socket carries both the video stream and the control events.
+     */
+    public static DesktopConnection open(Options options, boolean handshake) throws IOException {
+        if (!handshake) {
+            LocalSocket socket = openLegacySocket(options.isTunnelForward());
+            return new DesktopConnection(socket, socket, options.getControlProtocolVersion(), 0);
+        }
+
+        LocalSocket videoSocket;
+        LocalSocket controlSocket;
+        if (options.isTunnelForward()) {
+            LocalServerSocket localServerSocket = new LocalServerSocket(SOCKET_NAME);
+            try {
+                videoSocket = localServerSocket.accept();
+                // send one byte so the client may read() to detect a connection error
+                videoSocket.getOutputStream().write(SOCKET_TYPE_VIDEO);
+                try {
+                    controlSocket = localServerSocket.accept();
+                    controlSocket.getOutputStream().write(SOCKET_TYPE_CONTROL);
+                } catch (IOException | RuntimeException e) {
+                    videoSocket.close();
+                    throw e;
+                }
+            } finally {
+                localServerSocket.close();
+            }
+        } else {
+            videoSocket = connect(SOCKET_NAME);
+            try {
+                videoSocket.getOutputStream().write(SOCKET_TYPE_VIDEO);
+                controlSocket = connect(SOCKET_NAME);
+                controlSocket.getOutputStream().write(SOCKET_TYPE_CONTROL);
+            } catch (IOException | RuntimeException e) {
+                videoSocket.close();
+                throw e;
+            }
+        }
+
+        int clientVersion;
         try {
-            return localServerSocket.accept();
-        } finally {
-            localServerSocket.close();
+            // the control events are only sent after the hello, so nothing is consumed beyond it
+            clientVersion = Handshake.readOptions(controlSocket.getInputStream(), options);
+        } catch (IOException | RuntimeException e) {
+            videoSocket.close();
+            controlSocket.close();
+            throw e;
         }
+
+        int handshakeVersion = Handshake.negotiateVersion(clientVersion);
+        return new DesktopConnection(videoSocket, controlSocket, options.getControlProtocolVersion(), handshakeVersion);
     }
 
-    public static DesktopConnection open(Device device, boolean tunnelForward) throws IOException {
-        LocalSocket socket;
-        if (tunnelForward) {
-            socket = listenAndAccept(SOCKET_NAME);
+    private static LocalSocket openLegacySocket(boolean tunnelForward) throws IOException {
+        if (!tunnelForward) {
+            return connect(SOCKET_NAME);
+        }
+        LocalServerSocket localServerSocket = new LocalServerSocket(SOCKET_NAME);
+        try {
+            LocalSocket socket = localServerSocket.accept();
             // send one byte so the client may read() to detect a connection error
             socket.getOutputStream().write(0);
-        } else {
-            socket = connect(SOCKET_NAME);
+            return socket;
+        } finally {
+            localServerSocket.close();
         }
-
-        DesktopConnection connection = new DesktopConnection(socket);
-        Size videoSize = device.getScreenInfo().getVideoSize();
-        connection.send(Device.getDeviceName(), videoSize.getWidth(), videoSize.getHeight());
-        return connection;
     }
 
     public void close() throws IOException {
-        socket.shutdownInput();
-        socket.shutdownOutput();
-        socket.close();
+        videoSocket.shutdownInput();
+        videoSocket.shutdownOutput();
+        videoSocket.close();
+        if (controlSocket != videoSocket) {
+            controlSocket.shutdownInput();
+            controlSocket.shutdownOutput();
+            controlSocket.close();
+        }
     }
 
-    @SuppressWarnings("checkstyle:MagicNumber")
-    private void send(String deviceName, int width, int height) throws IOException {
-        byte[] buffer = new byte[DEVICE_NAME_FIELD_LENGTH + 4];
-
-        byte[] deviceNameBytes = deviceName.getBytes(StandardCharsets.UTF_8);
-        int len = Math.min(DEVICE_NAME_FIELD_LENGTH - 1, deviceNameBytes.length);
-        System.arraycopy(deviceNameBytes, 0, buffer, 0, len);
-        // byte[] are always 0-initialized in java, no need to set '\0' explicitly
-
-        buffer[DEVICE_NAME_FIELD_LENGTH] = (byte) (width >> 8);
-        buffer[DEVICE_NAME_FIELD_LENGTH + 1] = (byte) width;
-        buffer[DEVICE_NAME_FIELD_LENGTH + 2] = (byte) (height >> 8);
-        buffer[DEVICE_NAME_FIELD_LENGTH + 3] = (byte) height;
-        IO.writeFully(fd, buffer, 0, buffer.length);
+    public void sendDeviceInfo(Device device, VideoCodec codec, int capabilities) throws IOException {
+        Size videoSize = device.getScreenInfo().getVideoSize();
+        byte[] info;
+        if (handshakeVersion != 0) {
+            info = Handshake.serializeDeviceInfo(handshakeVersion, Device.getDeviceName(), videoSize, codec, controlProtocolVersion,
+                    capabilities);
+        } else {
+            // the legacy client only supports H.264 and the default control protocol, the options enforce them
+            info = Handshake.serializeLegacyDeviceInfo(Device.getDeviceName(), videoSize);
+        }
+        IO.writeFully(videoFd, info, 0, info.length);
     }
 
-    public FileDescriptor getFd() {
-        return fd;
+    public FileDescriptor getVideoFd() {
+        return videoFd;
     }
 
     public ControlEvent receiveControlEvent() throws IOException {
         ControlEvent event = reader.next();
         while (event == null) {
-            reader.readFrom(inputStream);
+            reader.readFrom(controlInputStream);
             event = reader.next();
         }
         return event;
     }
+
+    /**
+     * Append to the batch the mouse moves already received, without blocking.
+     *
+     * @return the first event received not appended to the batch, or {@code null}
+     */
+    public ControlEvent fillMotionBatch(MotionBatch batch) {
+        return batch.fill(reader);
+    }
 }
@@ -11,22 +11,42 @@ import android.view.InputEvent;
 
 public final class Device {
 
+    // the smallest region, relative to the initial content
+    private static final int MAX_ZOOM = 16;
+
     public interface RotationListener {
         void onRotationChanged(int rotation);
     }
 
     private final ServiceManager serviceManager = new ServiceManager();
 
-    private ScreenInfo screenInfo;
+    // replaced on rotation or max size change, read without locking (for every input event)
+    private volatile ScreenInfo screenInfo;
     private RotationListener rotationListener;
 
+    private final Rect crop;
+    private final boolean squareVideo;
+    private int maxSize;
+    // set if the content is a region requested by the client instead of the initial crop
+    private boolean regionSet;
+
     public Device(Options options) {
-        screenInfo = computeScreenInfo(options.getCrop(), options.getMaxSize());
+        crop = options.getCrop();
+        squareVideo = options.getSquareVideo();
+        maxSize = options.getMaxSize();
+        screenInfo = computeScreenInfo(crop, maxSize, squareVideo);
         registerRotationWatcher(new IRotationWatcher.Stub() {
             @Override
             public void onRotationChanged(int rotation) throws RemoteException {
+                // the lock only serializes the writers and the listener, the readers just read the volatile field
                 synchronized (Device.this) {
-                    screenInfo = screenInfo.withRotation(rotation);
+                    if (regionSet) {
+                        // the region does not follow the rotation, restore the initial crop
+                        regionSet = false;
+                        screenInfo = computeScreenInfo(crop, maxSize, squareVideo);
+                    } else {
+                        screenInfo = screenInfo.withRotation(rotation);
+                    }
 
                     // notify
                     if (rotationListener != null) {
@@ -37,12 +57,107 @@ public final class Device {
         });
     }
 
-    public synchronized ScreenInfo getScreenInfo() {
+    public ScreenInfo getScreenInfo() {
         return screenInfo;
     }
 
-    private ScreenInfo computeScreenInfo(Rect crop, int maxSize) {
+    /**
+     * Change the max size of the video, the encoder must be restarted if the video size changed.
+     * <p>
+     * The initial crop is restored.
+     *
+     * @return {@code true} if the video size changed
+     */
+    @SuppressWarnings("checkstyle:MagicNumber")
+    public synchronized boolean setMaxSize(int newMaxSize) {
+        int value = newMaxSize & ~7; // multiple of 8
+        if (value == maxSize) {
+            return false;
+        }
+        maxSize = value;
+        regionSet = false;
+        Size oldVideoSize = screenInfo.getVideoSize();
+        screenInfo = computeScreenInfo(crop, maxSize, squareVideo);
+        return !oldVideoSize.equals(screenInfo.getVideoSize());
+    }
+
+    /**
+     * Capture only a region of the current video (typically, to zoom), or restore the initial crop.
+     * <p>
+     * The region is enlarged to the aspect ratio of the video content (otherwise the projection would distort it), then moved
+     * inside the initial content if necessary. The video size does not change, so the encoder just has to update its projection.
+     *
+     * @param position the top-left corner of the region, in the video displayed by the client
+     * @param width    the width of the region in the video, 0 to restore the initial crop
+     * @param height   the height of the region in the video, 0 to restore the initial crop
+     * @return {@code true} if the captured content changed
+     */
+    public synchronized boolean setRegion(Position position, int width, int height) {
+        if (width == 0 || height == 0) {
+            return resetRegion();
+        }
+        ScreenInfo current = screenInfo;
+        Rect region = current.toDeviceRect(position, width, height);
+        if (region == null) {
+            // relative to a video having other dimensions (the device may have been rotated since the request), or in the letterbox
+            return false;
+        }
+        Rect videoContentRect = current.getVideoContentRect();
+        Size regionSize = fitAspectRatio(new Size(region.width(), region.height()),
+                new Size(videoContentRect.width(), videoContentRect.height()));
+        int regionLeft = region.centerX() - regionSize.getWidth() / 2;
+        int regionTop = region.centerY() - regionSize.getHeight() / 2;
+        region.set(regionLeft, regionTop, regionLeft + regionSize.getWidth(), regionTop + regionSize.getHeight());
         DisplayInfo displayInfo = serviceManager.getDisplayManager().getDisplayInfo();
+        Rect bounds = computeContentRect(crop, displayInfo);
+        if (region.width() >= bounds.width() || region.height() >= bounds.height()) {
+            // zoomed out to (or beyond) the initial content
+            return resetRegion();
+        }
+        if (region.width() * MAX_ZOOM < bounds.width() || region.height() * MAX_ZOOM < bounds.height()) {
+            Ln.w("Region too small: " + formatCrop(region));
+            return false;
+        }
+        // keep the size (and the aspect ratio) of the region, move it inside the bounds
+        int dx = Math.max(bounds.left - region.left, 0) + Math.min(bounds.right - region.right, 0);
+        int dy = Math.max(bounds.top - region.top, 0) + Math.min(bounds.bottom - region.bottom, 0);
+        region.offset(dx, dy);
+        regionSet = true;
+        screenInfo = current.withContentRect(region);
+        Ln.i("Region: " + formatCrop(region));
+        return true;
+    }
+
+    /**
+     * Grow the width or the height of a size, so that it has the given aspect ratio.
+     */
+    static Size fitAspectRatio(Size size, Size aspectRatio) {
+        int w = size.getWidth();
+        int h = size.getHeight();
+        // compare the ratios without division (in long, a region requested to zoom out may be much larger than the screen)
+        long widthProduct = (long) w * aspectRatio.getHeight();
+        long heightProduct = (long) h * aspectRatio.getWidth();
+        if (widthProduct > heightProduct) {
+            // too wide, grow the height (rounded up)
+            h = (int) ((widthProduct + aspectRatio.getWidth() - 1) / aspectRatio.getWidth());
+        } else if (widthProduct < heightProduct) {
+            // too tall, grow the width (rounded up)
+            w = (int) ((heightProduct + aspectRatio.getHeight() - 1) / aspectRatio.getHeight());
+        }
+        return new Size(w, h);
+    }
+
+    private boolean resetRegion() {
+        if (!regionSet) {
+            return false;
+        }
+        regionSet = false;
+        screenInfo = computeScreenInfo(crop, maxSize, squareVideo);
+        Ln.i("Region reset");
+        return true;
+    }
+
+    private static Rect computeContentRect(Rect crop, DisplayInfo displayInfo) {
         boolean rotated = (displayInfo.getRotation() & 1) != 0;
         Size deviceSize = displayInfo.getSize();
         Rect contentRect = new Rect(0, 0, deviceSize.getWidth(), deviceSize.getHeight());
@@ -57,8 +172,23 @@ public final class Device {
                 contentRect = new Rect(); // empty
             }
         }
+        return contentRect;
+    }
+
+    private ScreenInfo computeScreenInfo(Rect crop, int maxSize, boolean square) {
+        DisplayInfo displayInfo = serviceManager.getDisplayManager().getDisplayInfo();
+        boolean rotated = (displayInfo.getRotation() & 1) != 0;
+        Rect contentRect = computeContentRect(crop, displayInfo);
 
         Size videoSize = computeVideoSize(contentRect.width(), contentRect.height(), maxSize);
+        if (square) {
+            // letterbox the content into a square, so that the video size does not change on rotation
+            int side = Math.max(videoSize.getWidth(), videoSize.getHeight());
+            int left = (side - videoSize.getWidth()) / 2;
+            int top = (side - videoSize.getHeight()) / 2;
+            Rect videoContentRect = new Rect(left, top, left + videoSize.getWidth(), top + videoSize.getHeight());
+            return new ScreenInfo(contentRect, new Size(side, side), videoContentRect, rotated);
+        }
         return new ScreenInfo(contentRect, videoSize, rotated);
     }
 
@@ -95,21 +225,9 @@ public final class Device {
     }
 
     public Point getPhysicalPoint(Position position) {
-        // it hides the field on purpose, to read it with a lock
-        @SuppressWarnings("checkstyle:HiddenField")
-        ScreenInfo screenInfo = getScreenInfo(); // read with synchronization
-        Size videoSize = screenInfo.getVideoSize();
-        Size clientVideoSize = position.getScreenSize();
-        if (!videoSize.equals(clientVideoSize)) {
-            // The client sends a click relative to a video with wrong dimensions,
-            // the device may have been rotated since the event was generated, so ignore the event
-            return null;
-        }
-        Rect contentRect = screenInfo.getContentRect();
-        Point point = position.getPoint();
-        int scaledX = contentRect.left + point.x * contentRect.width() / videoSize.getWidth();
-        int scaledY = contentRect.top + point.y * contentRect.height() / videoSize.getHeight();
-        return new Point(scaledX, scaledY);
+        // If the client sends a click relative to a video with wrong dimensions (the device may have been rotated since the event was
+        // generated), then the result is null and the event must be ignored
+        return screenInfo.toDevicePoint(position);
     }
 
     public static String getDeviceName() {
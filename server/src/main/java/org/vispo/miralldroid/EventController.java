@@ -4,6 +4,7 @@ import org.vispo.miralldroid.wrappers.InputManager;
 
 import android.graphics.Point;
 import android.os.SystemClock;
+import android.util.SparseArray;
 import android.view.InputDevice;
 import android.view.InputEvent;
 import android.view.KeyCharacterMap;
@@ -17,16 +18,30 @@ public class EventController {
 
     private final Device device;
     private final DesktopConnection connection;
+    private final ScreenEncoder screenEncoder;
+
+    // only log the injection throughput for texts long enough to be meaningful
+    private static final int TEXT_STATS_MIN_LENGTH = 64;
+    // the key events generating a character are cached as (action, keycode, meta state) triples
+    private static final int KEY_FIELD_COUNT = 3;
+    // cached for the characters which cannot be injected
+    private static final int[] NO_KEYS = new int[0];
 
     private final KeyCharacterMap charMap = KeyCharacterMap.load(KeyCharacterMap.VIRTUAL_KEYBOARD);
+    // the keys generating each character already injected (the events are created on injection, with the current time)
+    private final SparseArray<int[]> charKeysCache = new SparseArray<>();
 
     private long lastMouseDown;
+    private final MotionBatch motionBatch = new MotionBatch();
+    // event received while filling the motion batch, to be handled next
+    private ControlEvent pendingEvent;
     private final MotionEvent.PointerProperties[] pointerProperties = {new MotionEvent.PointerProperties()};
     private final MotionEvent.PointerCoords[] pointerCoords = {new MotionEvent.PointerCoords()};
 
-    public EventController(Device device, DesktopConnection connection) {
+    public EventController(Device device, DesktopConnection connection, ScreenEncoder screenEncoder) {
         this.device = device;
         this.connection = connection;
+        this.screenEncoder = screenEncoder;
         initPointer();
     }
 
@@ -63,7 +78,11 @@ public class EventController {
     }
 
     private void handleEvent() throws IOException {
-        ControlEvent controlEvent = connection.receiveControlEvent();
+        ControlEvent controlEvent = pendingEvent;
+        pendingEvent = null;
+        if (controlEvent == null) {
+            controlEvent = connection.receiveControlEvent();
+        }
         switch (controlEvent.getType()) {
             case ControlEvent.TYPE_KEYCODE:
                 injectKeycode(controlEvent.getAction(), controlEvent.getKeycode(), controlEvent.getMetaState());
@@ -72,7 +91,14 @@ public class EventController {
                 injectText(controlEvent.getText());
                 break;
             case ControlEvent.TYPE_MOUSE:
-                injectMouse(controlEvent.getAction(), controlEvent.getButtons(), controlEvent.getPosition());
+                if (controlEvent.getAction() == MotionEvent.ACTION_MOVE) {
+                    // fold the moves already received into a single event
+                    motionBatch.start(controlEvent);
+                    pendingEvent = connection.fillMotionBatch(motionBatch);
+                    injectMotionBatch(motionBatch);
+                } else {
+                    injectMouse(controlEvent.getAction(), controlEvent.getButtons(), controlEvent.getPosition());
+                }
                 break;
             case ControlEvent.TYPE_SCROLL:
                 injectScroll(controlEvent.getPosition(), controlEvent.getHScroll(), controlEvent.getVScroll());
@@ -80,6 +106,15 @@ public class EventController {
             case ControlEvent.TYPE_COMMAND:
                 executeCommand(controlEvent.getAction());
                 break;
+            case ControlEvent.TYPE_VIDEO:
+                // applied asynchronously by the encoder
+                screenEncoder.changeSettings(controlEvent.getBitRate(), controlEvent.getMaxSize(), controlEvent.getFrameRate());
+                break;
+            case ControlEvent.TYPE_REGION:
+                if (device.setRegion(controlEvent.getPosition(), controlEvent.getWidth(), controlEvent.getHeight())) {
+                    screenEncoder.onRegionChanged();
+                }
+                break;
             default:
                 // do nothing
         }
@@ -89,27 +124,54 @@ public class EventController {
         return injectKeyEvent(action, keycode, 0, metaState);
     }
 
+    private int[] getCharKeys(char c) {
+        int[] keys = charKeysCache.get(c);
+        if (keys == null) {
+            String decomposed = KeyComposition.decompose(c);
+            char[] chars = decomposed != null ? decomposed.toCharArray() : new char[] {c};
+            KeyEvent[] events = charMap.getEvents(chars);
+            if (events == null) {
+                keys = NO_KEYS;
+            } else {
+                keys = new int[events.length * KEY_FIELD_COUNT];
+                for (int i = 0; i < events.length; ++i) {
+                    KeyEvent event = events[i];
+                    keys[i * KEY_FIELD_COUNT] = event.getAction();
+                    keys[i * KEY_FIELD_COUNT + 1] = event.getKeyCode();
+                    keys[i * KEY_FIELD_COUNT + 2] = event.getMetaState();
+                }
+            }
+            charKeysCache.put(c, keys);
+        }
+        return keys;
+    }
+
     private boolean injectChar(char c) {
-        String decomposed = KeyComposition.decompose(c);
-        char[] chars = decomposed != null ? decomposed.toCharArray() : new char[] {c};
-        KeyEvent[] events = charMap.getEvents(chars);
-        if (events == null) {
+        int[] keys = getCharKeys(c);
+        if (keys.length == 0) {
             return false;
         }
-        for (KeyEvent event : events) {
-            if (!injectEvent(event)) {
+        for (int i = 0; i < keys.length; i += KEY_FIELD_COUNT) {
+            if (!injectKeycode(keys[i], keys[i + 1], keys[i + 2])) {
                 return false;
             }
         }
         return true;
     }
 
+    @SuppressWarnings("checkstyle:MagicNumber")
     private boolean injectText(String text) {
-        for (char c : text.toCharArray()) {
-            if (!injectChar(c)) {
+        long start = SystemClock.uptimeMillis();
+        int len = text.length();
+        for (int i = 0; i < len; ++i) {
+            if (!injectChar(text.charAt(i))) {
                 return false;
             }
         }
+        if (len >= TEXT_STATS_MIN_LENGTH) {
+            long elapsed = Math.max(1, SystemClock.uptimeMillis() - start);
+            Ln.d("Injected " + len + " chars in " + elapsed + " ms (" + (len * 1000 / elapsed) + " chars/s)");
+        }
         return true;
     }
 
@@ -126,7 +188,35 @@ public class EventController {
         setPointerCoords(point);
         MotionEvent event = MotionEvent.obtain(lastMouseDown, now, action, 1, pointerProperties, pointerCoords, 0, buttons, 1f, 1f, 0, 0,
                 InputDevice.SOURCE_TOUCHSCREEN, 0);
-        return injectEvent(event);
+        return injectMotionEvent(event);
+    }
+
+    private boolean injectMotionBatch(MotionBatch batch) {
+        long now = SystemClock.uptimeMillis();
+        int size = batch.size();
+        long lastTimestamp = batch.getTimestamp(size - 1);
+        MotionEvent event = null;
+        for (int i = 0; i < size; ++i) {
+            Point point = device.getPhysicalPoint(batch.getPosition(i));
+            if (point == null) {
+                // skip only this sample, the others (including the final position, before a possible UP) are still valid
+                continue;
+            }
+            setPointerCoords(point);
+            // keep the client intervals between samples, the last one is "now"
+            long eventTime = Math.max(lastMouseDown, now - (lastTimestamp - batch.getTimestamp(i)));
+            if (event == null) {
+                event = MotionEvent.obtain(lastMouseDown, eventTime, MotionEvent.ACTION_MOVE, 1, pointerProperties, pointerCoords, 0,
+                        batch.getButtons(), 1f, 1f, 0, 0, InputDevice.SOURCE_TOUCHSCREEN, 0);
+            } else {
+                event.addBatch(eventTime, pointerCoords, 0);
+            }
+        }
+        if (event == null) {
+            // no valid sample
+            return false;
+        }
+        return injectMotionEvent(event);
     }
 
     private boolean injectScroll(Position position, int hScroll, int vScroll) {
@@ -140,7 +230,7 @@ public class EventController {
         setScroll(hScroll, vScroll);
         MotionEvent event = MotionEvent.obtain(lastMouseDown, now, MotionEvent.ACTION_SCROLL, 1, pointerProperties, pointerCoords, 0, 0, 1f, 1f, 0,
                 0, InputDevice.SOURCE_MOUSE, 0);
-        return injectEvent(event);
+        return injectMotionEvent(event);
     }
 
     private boolean injectKeyEvent(int action, int keyCode, int repeat, int metaState) {
@@ -159,6 +249,13 @@ public class EventController {
         return device.injectInputEvent(event, InputManager.INJECT_INPUT_EVENT_MODE_ASYNC);
     }
 
+    // the event is copied by the injection (it is parceled), so it can be returned to the pool
+    private boolean injectMotionEvent(MotionEvent event) {
+        boolean ok = injectEvent(event);
+        event.recycle();
+        return ok;
+    }
+
     private boolean turnScreenOn() {
         return device.isScreenOn() || injectKeycode(KeyEvent.KEYCODE_POWER);
     }
@@ -172,6 +269,12 @@ public class EventController {
         switch (action) {
             case ControlEvent.COMMAND_BACK_OR_SCREEN_ON:
                 return pressBackOrTurnScreenOn();
+            case ControlEvent.COMMAND_PAUSE_VIDEO:
+                screenEncoder.setPaused(true);
+                return true;
+            case ControlEvent.COMMAND_RESUME_VIDEO:
+                screenEncoder.setPaused(false);
+                return true;
             default:
                 Ln.w("Unsupported command: " + action);
         }
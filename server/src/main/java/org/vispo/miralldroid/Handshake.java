@@ -0,0 +1,241 @@
+package org.vispo.miralldroid;
+
+import java.io.DataInputStream;
+import java.io.IOException;
+import java.io.InputStream;
+import java.nio.ByteBuffer;
+import java.nio.charset.StandardCharsets;
+
+/**
+ * The "hello" messages exchanged once the sockets are connected (see handshake.h in the client).
+ * <p>
+ * The client sends its options on the control socket, the server answers with the device info on the video socket. Each message is a
+ * header (the version on 1 byte, the payload length on 2 bytes) followed by TLV entries (the type on 1 byte, the value length on 2 bytes,
+ * the value). Unknown entries are skipped, absent entries keep their default values.
+ * <p>
+ * The server answers with the lowest of both versions. The clients not supporting the handshake pass their options as positional
+ * arguments, and receive the device info in the legacy fixed-size format.
+ */
+public final class Handshake {
+
+    public static final int VERSION = 1;
+    public static final int LEGACY_DEVICE_INFO_LENGTH = 68;
+    public static final int HEADER_LENGTH = 3;
+    public static final int MAX_PAYLOAD_LENGTH = 1024;
+
+    private static final int ENTRY_HEADER_LENGTH = 3;
+
+    // the entries sent by the client
+    private static final int OPTION_MAX_SIZE = 1;
+    private static final int OPTION_BIT_RATE = 2;
+    private static final int OPTION_CROP = 3;
+    private static final int OPTION_SEND_FRAME_META = 4;
+    private static final int OPTION_CONTROL_PROTOCOL_VERSION = 5;
+    private static final int OPTION_SQUARE_VIDEO = 6;
+    private static final int OPTION_CODEC = 7;
+
+    // the entries sent by the server
+    private static final int INFO_DEVICE_NAME = 1;
+    private static final int INFO_VIDEO_SIZE = 2;
+    private static final int INFO_CODEC = 3;
+    private static final int INFO_CONTROL_PROTOCOL_VERSION = 4;
+    private static final int INFO_CAPABILITIES = 5;
+
+    public static final int CAPABILITY_H265_ENCODER = 1;
+    public static final int CAPABILITY_REGION = 2;
+    public static final int CAPABILITY_PAUSE_VIDEO = 4;
+
+    private static final int DEFAULT_BIT_RATE = 8000000;
+    private static final int DEVICE_NAME_FIELD_LENGTH = 64; // the client stores it in 64 bytes, including '\0'
+
+    private Handshake() {
+        // not instantiable
+    }
+
+    /**
+     * Read the client hello.
+     *
+     * @return the handshake version of the client
+     */
+    public static int readOptions(InputStream input, Options options) throws IOException {
+        DataInputStream dis = new DataInputStream(input);
+        byte[] header = new byte[HEADER_LENGTH];
+        dis.readFully(header);
+        byte[] payload = new byte[parseHeader(header)];
+        dis.readFully(payload);
+        parseOptions(ByteBuffer.wrap(payload), options);
+        return header[0] & 0xff;
+    }
+
+    /**
+     * Return the version of the server hello, for a client hello of the given version.
+     * <p>
+     * A more recent client only adds entries to its hello, which are skipped; it must accept an answer of an older version.
+     */
+    public static int negotiateVersion(int clientVersion) {
+        return Math.min(clientVersion, VERSION);
+    }
+
+    /**
+     * Parse the header of a hello message.
+     * <p>
+     * Any version is accepted, a message of a more recent version only adds entries.
+     *
+     * @return the payload length
+     */
+    @SuppressWarnings("checkstyle:MagicNumber")
+    public static int parseHeader(byte[] header) throws IOException {
+        int version = header[0] & 0xff;
+        if (version < 1) {
+            throw new IOException("Invalid handshake version: " + version);
+        }
+        int len = ((header[1] & 0xff) << 8) | (header[2] & 0xff);
+        if (len > MAX_PAYLOAD_LENGTH) {
+            throw new IOException("Handshake payload too long: " + len);
+        }
+        return len;
+    }
+
+    /**
+     * Parse the payload of the client hello.
+     * <p>
+     * The tunnel mode is not part of the handshake, it is left untouched.
+     */
+    @SuppressWarnings("checkstyle:MagicNumber")
+    public static void parseOptions(ByteBuffer payload, Options options) throws IOException {
+        // the defaults for the entries not sent by the client
+        options.setMaxSize(0);
+        options.setBitRate(DEFAULT_BIT_RATE);
+        options.setCrop(null);
+        options.setSendFrameMeta(false);
+        options.setControlProtocolVersion(ControlEventReader.PROTOCOL_VERSION_1);
+        options.setSquareVideo(false);
+        options.setCodec(VideoCodec.H264);
+
+        while (payload.hasRemaining()) {
+            if (payload.remaining() < ENTRY_HEADER_LENGTH) {
+                throw new IOException("Truncated handshake entry");
+            }
+            int type = payload.get() & 0xff;
+            int len = payload.getShort() & 0xffff;
+            if (payload.remaining() < len) {
+                throw new IOException("Truncated handshake entry " + type);
+            }
+            ByteBuffer value = payload.slice();
+            value.limit(len);
+            payload.position(payload.position() + len);
+            parseOption(type, value, options);
+        }
+    }
+
+    @SuppressWarnings("checkstyle:MagicNumber")
+    private static void parseOption(int type, ByteBuffer value, Options options) throws IOException {
+        int len = value.remaining();
+        switch (type) {
+            case OPTION_MAX_SIZE:
+                checkLength(type, len, 2);
+                options.setMaxSize((value.getShort() & 0xffff) & ~7); // multiple of 8
+                break;
+            case OPTION_BIT_RATE:
+                checkLength(type, len, 4);
+                options.setBitRate(value.getInt());
+                break;
+            case OPTION_CROP:
+                byte[] crop = new byte[len];
+                value.get(crop);
+                options.setCrop(Server.parseCrop(new String(crop, StandardCharsets.UTF_8)));
+                break;
+            case OPTION_SEND_FRAME_META:
+                checkLength(type, len, 1);
+                options.setSendFrameMeta(value.get() != 0);
+                break;
+            case OPTION_CONTROL_PROTOCOL_VERSION:
+                checkLength(type, len, 1);
+                // a more recent client may request a version not supported yet, it will use the one returned in the device info
+                int version = Math.min(value.get() & 0xff, ControlEventReader.PROTOCOL_VERSION_2);
+                options.setControlProtocolVersion(version);
+                break;
+            case OPTION_SQUARE_VIDEO:
+                checkLength(type, len, 1);
+                options.setSquareVideo(value.get() != 0);
+                break;
+            case OPTION_CODEC:
+                checkLength(type, len, 1);
+                VideoCodec codec = VideoCodec.findById(value.get() & 0xff);
+                // the codec is only a preference
+                options.setCodec(codec != null ? codec : VideoCodec.H264);
+                break;
+            default:
+                // sent by a more recent client, ignore it
+                break;
+        }
+    }
+
+    private static void checkLength(int type, int len, int expected) throws IOException {
+        if (len != expected) {
+            throw new IOException("Invalid length " + len + " for handshake entry " + type);
+        }
+    }
+
+    /**
+     * Serialize the server hello, header included.
+     *
+     * @param version the negotiated version (see {@link #negotiateVersion(int)})
+     */
+    @SuppressWarnings("checkstyle:MagicNumber")
+    public static byte[] serializeDeviceInfo(int version, String deviceName, Size videoSize, VideoCodec codec, int controlProtocolVersion,
+            int capabilities) {
+        byte[] deviceNameBytes = deviceName.getBytes(StandardCharsets.UTF_8);
+        int nameLength = Math.min(DEVICE_NAME_FIELD_LENGTH - 1, deviceNameBytes.length);
+
+        int payloadLength = 5 * ENTRY_HEADER_LENGTH + nameLength + 4 + 1 + 1 + 4;
+        ByteBuffer buffer = ByteBuffer.allocate(HEADER_LENGTH + payloadLength);
+        buffer.put((byte) version);
+        buffer.putShort((short) payloadLength);
+
+        putEntryHeader(buffer, INFO_DEVICE_NAME, nameLength);
+        buffer.put(deviceNameBytes, 0, nameLength);
+
+        putEntryHeader(buffer, INFO_VIDEO_SIZE, 4);
+        buffer.putShort((short) videoSize.getWidth());
+        buffer.putShort((short) videoSize.getHeight());
+
+        putEntryHeader(buffer, INFO_CODEC, 1);
+        buffer.put((byte) codec.getId());
+
+        putEntryHeader(buffer, INFO_CONTROL_PROTOCOL_VERSION, 1);
+        buffer.put((byte) controlProtocolVersion);
+
+        putEntryHeader(buffer, INFO_CAPABILITIES, 4);
+        buffer.putInt(capabilities);
+
+        return buffer.array();
+    }
+
+    /**
+     * Serialize the device info for the clients not supporting the handshake: the device name on 64 bytes ('\0'-terminated), then
+     * the video width and height on 2 bytes each.
+     */
+    @SuppressWarnings("checkstyle:MagicNumber")
+    public static byte[] serializeLegacyDeviceInfo(String deviceName, Size videoSize) {
+        byte[] buffer = new byte[LEGACY_DEVICE_INFO_LENGTH];
+
+        byte[] deviceNameBytes = deviceName.getBytes(StandardCharsets.UTF_8);
+        int len = Math.min(DEVICE_NAME_FIELD_LENGTH - 1, deviceNameBytes.length);
+        System.arraycopy(deviceNameBytes, 0, buffer, 0, len);
+        // byte[] are always 0-initialized in java, no need to set '\0' explicitly
+
+        int width = videoSize.getWidth();
+        int height = videoSize.getHeight();
+        buffer[DEVICE_NAME_FIELD_LENGTH] = (byte) (width >> 8);
+        buffer[DEVICE_NAME_FIELD_LENGTH + 1] = (byte) width;
+        buffer[DEVICE_NAME_FIELD_LENGTH + 2] = (byte) (height >> 8);
+        buffer[DEVICE_NAME_FIELD_LENGTH + 3] = (byte) height;
+        return buffer;
+    }
+
+    private static void putEntryHeader(ByteBuffer buffer, int type, int len) {
+        buffer.put((byte) type);
+        buffer.putShort((short) len);
+    }
+}
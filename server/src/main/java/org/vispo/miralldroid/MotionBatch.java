@@ -0,0 +1,84 @@
+package org.vispo.miralldroid;
+
+import android.view.MotionEvent;
+
+/**
+ * Consecutive mouse move events, to be injected as a single {@link MotionEvent} with historical samples.
+ */
+public final class MotionBatch {
+
+    public static final int MAX_SIZE = 32;
+
+    private final Position[] positions = new Position[MAX_SIZE];
+    private final long[] timestamps = new long[MAX_SIZE];
+    private int size;
+    private int buttons;
+
+    public MotionBatch() {
+        // the events returned by the reader are reused, so the positions are copied into preallocated instances
+        for (int i = 0; i < MAX_SIZE; ++i) {
+            positions[i] = new Position(0, 0, null);
+        }
+    }
+
+    /**
+     * Start a new batch with a mouse move event.
+     */
+    public void start(ControlEvent event) {
+        size = 0;
+        buttons = event.getButtons();
+        add(event);
+    }
+
+    private void add(ControlEvent event) {
+        Position position = event.getPosition();
+        positions[size].set(position.getX(), position.getY(), position.getScreenSize());
+        timestamps[size] = event.getTimestamp();
+        ++size;
+    }
+
+    /**
+     * Whether the event may be appended: a mouse move with the same buttons and screen size, and a more recent client timestamp (so
+     * that the samples have distinct times, the timestamps are not available with the protocol v1).
+     */
+    public boolean accepts(ControlEvent event) {
+        return size < MAX_SIZE
+                && event.getType() == ControlEvent.TYPE_MOUSE
+                && event.getAction() == MotionEvent.ACTION_MOVE
+                && event.getButtons() == buttons
+                && event.getPosition().getScreenSize().equals(positions[0].getScreenSize())
+                && event.getTimestamp() > timestamps[size - 1];
+    }
+
+    /**
+     * Append the events already received by the reader (without blocking) as long as they are accepted.
+     *
+     * @return the first event not appended, to be handled after the batch, or {@code null}
+     */
+    public ControlEvent fill(ControlEventReader reader) {
+        ControlEvent event;
+        while ((event = reader.next()) != null) {
+            if (!accepts(event)) {
+                return event;
+            }
+            add(event);
+        }
+        return null;
+    }
+
+    public int size() {
+        return size;
+    }
+
+    public int getButtons() {
+        return buttons;
+    }
+
+    public Position getPosition(int index) {
+        return positions[index];
+    }
+
+    public long getTimestamp(int index) {
+        return timestamps[index];
+    }
+}
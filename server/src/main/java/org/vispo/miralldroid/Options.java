@@ -8,6 +8,9 @@ public class Options {
     private boolean tunnelForward;
     private Rect crop;
     private boolean sendFrameMeta; // send PTS so that the client may record properly
+    private int controlProtocolVersion;
+    private boolean squareVideo; // letterbox into a square, so that the encoder survives rotations
+    private VideoCodec codec; // the preferred codec, H.264 is used if the device has no encoder for it
 
     public int getMaxSize() {
         return maxSize;
@@ -48,4 +51,28 @@ public class Options {
     public void setSendFrameMeta(boolean sendFrameMeta) {
         this.sendFrameMeta = sendFrameMeta;
     }
+
+    public int getControlProtocolVersion() {
+        return controlProtocolVersion;
+    }
+
+    public void setControlProtocolVersion(int controlProtocolVersion) {
+        this.controlProtocolVersion = controlProtocolVersion;
+    }
+
+    public boolean getSquareVideo() {
+        return squareVideo;
+    }
+
+    public void setSquareVideo(boolean squareVideo) {
+        this.squareVideo = squareVideo;
+    }
+
+    public VideoCodec getCodec() {
+        return codec;
+    }
+
+    public void setCodec(VideoCodec codec) {
+        this.codec = codec;
+    }
 }
@@ -0,0 +1,162 @@
+package org.vispo.miralldroid;
+
+import java.nio.ByteBuffer;
+import java.util.concurrent.ArrayBlockingQueue;
+import java.util.concurrent.BlockingQueue;
+import java.util.concurrent.LinkedBlockingQueue;
+
+/**
+ * Bounded queue of encoded packets between the encoder (producer) and the socket writer (consumer).
+ * <p>
+ * The packets are taken from a fixed pool, so that a slow client cannot make the server buffer seconds of video. When the pool is
+ * exhausted, the packet and all the following ones are dropped until the next key frame (the rest of the GOP cannot be decoded anyway),
+ * and the producer is asked to request a sync frame.
+ */
+public final class PacketQueue {
+
+    public static final class Packet {
+        private ByteBuffer data;
+        private long pts;
+
+        private Packet() {
+        }
+
+        public ByteBuffer getData() {
+            return data;
+        }
+
+        public long getPts() {
+            return pts;
+        }
+
+        private void set(ByteBuffer from, long newPts) {
+            int len = from.remaining();
+            if (data == null || data.capacity() < len) {
+                data = ByteBuffer.allocateDirect(len);
+            }
+            data.clear();
+            data.put(from);
+            data.flip();
+            pts = newPts;
+        }
+    }
+
+    // queued to wake up the consumer on close
+    private static final Packet STOP = new Packet();
+
+    private final int capacity;
+    private final BlockingQueue<Packet> free;
+    // bounded by the pool (plus the config packets, which are never dropped)
+    private final BlockingQueue<Packet> ready = new LinkedBlockingQueue<>();
+
+    // only accessed by the producer
+    private boolean dropping;
+    private boolean syncFrameRequested;
+    private long droppedCount;
+    private int maxSize;
+
+    public PacketQueue(int capacity) {
+        this.capacity = capacity;
+        free = new ArrayBlockingQueue<>(capacity);
+        for (int i = 0; i < capacity; ++i) {
+            free.add(new Packet());
+        }
+    }
+
+    /**
+     * Copy the packet (the remaining bytes of {@code data}) into the queue, or drop it.
+     * <p>
+     * Must be called by the producer only.
+     *
+     * @param config whether the packet contains the codec config (never dropped)
+     * @return {@code true} if the packet is queued, {@code false} if it is dropped
+     */
+    public boolean offer(ByteBuffer data, long pts, boolean keyFrame, boolean config) {
+        if (dropping && keyFrame) {
+            dropping = false;
+        }
+
+        if (dropping && !config) {
+            ++droppedCount;
+            return false;
+        }
+
+        Packet packet = free.poll();
+        if (packet == null) {
+            if (!config) {
+                dropping = true;
+                syncFrameRequested = true;
+                ++droppedCount;
+                return false;
+            }
+            // the config must reach the client, allocate a packet outside the pool
+            packet = new Packet();
+        }
+        packet.set(data, pts);
+        ready.add(packet);
+        maxSize = Math.max(maxSize, ready.size());
+        return true;
+    }
+
+    /**
+     * Return whether a sync frame must be requested to the encoder since the last call.
+     */
+    public boolean consumeSyncFrameRequest() {
+        boolean result = syncFrameRequested;
+        syncFrameRequested = false;
+        return result;
+    }
+
+    /**
+     * Return whether the packets are being dropped until the next key frame.
+     */
+    public boolean isDropping() {
+        return dropping;
+    }
+
+    public long getDroppedCount() {
+        return droppedCount;
+    }
+
+    /**
+     * Return the number of packets waiting to be written.
+     */
+    public int size() {
+        return ready.size();
+    }
+
+    /**
+     * Return the maximum number of packets waiting to be written observed by the producer.
+     */
+    public int getMaxSize() {
+        return maxSize;
+    }
+
+    /**
+     * Wait for the next packet to write.
+     * <p>
+     * Must be called by the consumer only, and the packet must be given back by {@link #recycle(Packet)} once written.
+     *
+     * @return the packet, or {@code null} once the queue is closed
+     */
+    public Packet take() throws InterruptedException {
+        Packet packet = ready.take();
+        return packet != STOP ? packet : null;
+    }
+
+    /**
+     * Make the consumer stop after the packets already queued.
+     */
+    public void close() {
+        ready.add(STOP);
+    }
+
+    public void recycle(Packet packet) {
+        // the packets allocated outside the pool are not kept if the pool is full
+        free.offer(packet);
+    }
+
+    public int getCapacity() {
+        return capacity;
+    }
+}
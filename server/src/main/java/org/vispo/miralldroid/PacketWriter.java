@@ -0,0 +1,55 @@
+package org.vispo.miralldroid;
+
+import java.io.IOException;
+import java.nio.ByteBuffer;
+import java.nio.channels.GatheringByteChannel;
+
+/**
+ * Write the encoded packets to the video socket, optionally prefixed by their meta header.
+ * <p>
+ * The header and the payload are gathered into a single write, so that they are not sent as separate segments.
+ */
+public final class PacketWriter {
+
+    public static final int HEADER_LENGTH = 12;
+    public static final long NO_PTS = -1;
+
+    private final GatheringByteChannel channel;
+    private final boolean sendFrameMeta;
+    private final ByteBuffer header = ByteBuffer.allocate(HEADER_LENGTH);
+    private final ByteBuffer[] buffers = {header, null};
+
+    public PacketWriter(GatheringByteChannel channel, boolean sendFrameMeta) {
+        this.channel = channel;
+        this.sendFrameMeta = sendFrameMeta;
+    }
+
+    /**
+     * Write the packet (the remaining bytes of {@code payload}).
+     *
+     * @param pts the presentation timestamp, or {@link #NO_PTS} for a config packet (ignored if the meta are not sent)
+     */
+    public void write(long pts, ByteBuffer payload) throws IOException {
+        if (!sendFrameMeta) {
+            while (payload.hasRemaining()) {
+                channel.write(payload);
+            }
+            return;
+        }
+
+        header.clear();
+        header.putLong(pts);
+        header.putInt(payload.remaining());
+        header.flip();
+
+        buffers[1] = payload;
+        try {
+            // the channel may write partially, in particular for a non-blocking socket
+            while (payload.hasRemaining() || header.hasRemaining()) {
+                channel.write(buffers);
+            }
+        } finally {
+            buffers[1] = null;
+        }
+    }
+}
@@ -1,24 +1,35 @@
 package org.vispo.miralldroid;
 
-import android.graphics.Point;
-
 import java.util.Objects;
 
 public class Position {
-    private Point point;
+    private int x;
+    private int y;
     private Size screenSize;
 
-    public Position(Point point, Size screenSize) {
-        this.point = point;
+    public Position(int x, int y, Size screenSize) {
+        this.x = x;
+        this.y = y;
         this.screenSize = screenSize;
     }
 
     public Position(int x, int y, int screenWidth, int screenHeight) {
-        this(new Point(x, y), new Size(screenWidth, screenHeight));
+        this(x, y, new Size(screenWidth, screenHeight));
+    }
+
+    // only used to reuse the instance, a Position is otherwise a value
+    void set(int newX, int newY, Size newScreenSize) {
+        x = newX;
+        y = newY;
+        screenSize = newScreenSize;
+    }
+
+    public int getX() {
+        return x;
     }
 
-    public Point getPoint() {
-        return point;
+    public int getY() {
+        return y;
     }
 
     public Size getScreenSize() {
@@ -34,19 +45,21 @@ public class Position {
             return false;
         }
         Position position = (Position) o;
-        return Objects.equals(point, position.point)
+        return x == position.x
+                && y == position.y
                 && Objects.equals(screenSize, position.screenSize);
     }
 
     @Override
     public int hashCode() {
-        return Objects.hash(point, screenSize);
+        return Objects.hash(x, y, screenSize);
     }
 
     @Override
     public String toString() {
         return "Position{"
-                + "point=" + point
+                + "x=" + x
+                + ", y=" + y
                 + ", screenSize=" + screenSize
                 + '}';
     }
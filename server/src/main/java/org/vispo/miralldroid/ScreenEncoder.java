@@ -6,12 +6,16 @@ import android.graphics.Rect;
 import android.media.MediaMuxer;
 import android.media.MediaCodec;
 import android.media.MediaCodecInfo;
+import android.media.MediaCodecList;
 import android.media.MediaFormat;
+import android.os.Bundle;
 import android.os.IBinder;
 import android.view.Surface;
 
 import java.io.FileDescriptor;
+import java.io.FileOutputStream;
 import java.io.IOException;
+import java.io.InterruptedIOException;
 import java.nio.ByteBuffer;
 import java.util.concurrent.atomic.AtomicBoolean;
 
@@ -23,87 +27,305 @@ public class ScreenEncoder implements Device.RotationListener {
     private static final int REPEAT_FRAME_DELAY = 6; // repeat after 6 frames
 
     private static final int MICROSECONDS_IN_ONE_SECOND = 1_000_000;
-    private static final int NO_PTS = -1;
 
-    private final AtomicBoolean rotationChanged = new AtomicBoolean();
-    private final ByteBuffer headerBuffer = ByteBuffer.allocate(12);
+    // MediaFormat.KEY_MAX_FPS_TO_ENCODER, added in API 29 (ignored before)
+    private static final String KEY_MAX_FPS_TO_ENCODER = "max-fps-to-encoder";
+
+    // packets waiting to be written to the socket, beyond that the GOP tail is dropped
+    private static final int VIDEO_QUEUE_CAPACITY = 16;
+
+    // set on rotation or region change
+    private final AtomicBoolean screenInfoChanged = new AtomicBoolean();
+    private final AtomicBoolean settingsChanged = new AtomicBoolean();
+    // settings requested by the client, guarded by "this" (0 if unchanged)
+    private int requestedBitRate;
+    private int requestedMaxSize;
+    private int requestedFrameRate;
+    // set by the writer thread
+    private volatile IOException writeError;
+    // written with "this" held (to notify the encoder thread)
+    private volatile boolean paused;
 
     private int bitRate;
     private int frameRate;
+    // only limit the frame rate once changed by the client (the default is just a hint to the encoder)
+    private boolean frameRateLimited;
     private int iFrameInterval;
     private boolean sendFrameMeta;
+    private final VideoCodec videoCodec;
+    // the size the codec is configured with
+    private Size videoSize;
     private long ptsOrigin;
 
-    public ScreenEncoder(boolean sendFrameMeta, int bitRate, int frameRate, int iFrameInterval) {
+    public ScreenEncoder(boolean sendFrameMeta, int bitRate, VideoCodec videoCodec, int frameRate, int iFrameInterval) {
         this.sendFrameMeta = sendFrameMeta;
         this.bitRate = bitRate;
+        this.videoCodec = videoCodec;
         this.frameRate = frameRate;
         this.iFrameInterval = iFrameInterval;
     }
 
-    public ScreenEncoder(boolean sendFrameMeta, int bitRate) {
-        this(sendFrameMeta, bitRate, DEFAULT_FRAME_RATE, DEFAULT_I_FRAME_INTERVAL);
+    public ScreenEncoder(boolean sendFrameMeta, int bitRate, VideoCodec videoCodec) {
+        this(sendFrameMeta, bitRate, videoCodec, DEFAULT_FRAME_RATE, DEFAULT_I_FRAME_INTERVAL);
+    }
+
+    /**
+     * Select the codec to use: the requested one if the device has an encoder for it, H.264 (always available) otherwise.
+     */
+    public static VideoCodec selectCodec(VideoCodec requested) {
+        if (requested == VideoCodec.H264 || hasEncoder(requested.getMimeType())) {
+            return requested;
+        }
+        Ln.w("No " + requested.getName() + " encoder on the device, fallback to " + VideoCodec.H264.getName());
+        return VideoCodec.H264;
+    }
+
+    public static boolean hasEncoder(String mimeType) {
+        MediaCodecList codecList = new MediaCodecList(MediaCodecList.REGULAR_CODECS);
+        for (MediaCodecInfo info : codecList.getCodecInfos()) {
+            if (!info.isEncoder()) {
+                continue;
+            }
+            for (String type : info.getSupportedTypes()) {
+                if (type.equalsIgnoreCase(mimeType)) {
+                    return true;
+                }
+            }
+        }
+        return false;
     }
 
     @Override
     public void onRotationChanged(int rotation) {
-        rotationChanged.set(true);
+        screenInfoChanged.set(true);
     }
 
-    public boolean consumeRotationChange() {
-        return rotationChanged.getAndSet(false);
+    /**
+     * Notify that the region of the screen to capture changed (see {@link Device#setRegion(Position, int, int)}).
+     */
+    public void onRegionChanged() {
+        screenInfoChanged.set(true);
+    }
+
+    public boolean consumeScreenInfoChange() {
+        return screenInfoChanged.getAndSet(false);
+    }
+
+    /**
+     * Request new encoding settings, applied by the encoder thread on the next packet.
+     * <p>
+     * A value of 0 keeps the current setting. The bit-rate is changed on the fly, the other settings reconfigure the codec.
+     */
+    public synchronized void changeSettings(int bitRate, int maxSize, int frameRate) {
+        if (bitRate != 0) {
+            requestedBitRate = bitRate;
+        }
+        if (maxSize != 0) {
+            requestedMaxSize = maxSize;
+        }
+        if (frameRate != 0) {
+            requestedFrameRate = frameRate;
+        }
+        settingsChanged.set(true);
+    }
+
+    /**
+     * Pause or resume the encoding (typically while the client window is minimized).
+     * <p>
+     * While paused, the display does not render to the codec, so nothing is encoded. On resume, the codec is restarted, so the
+     * first frame is a key frame.
+     */
+    public synchronized void setPaused(boolean paused) {
+        this.paused = paused;
+        notifyAll();
     }
 
     public void streamScreen(Device device, FileDescriptor fd) throws IOException {
-        MediaFormat format = createFormat(bitRate, frameRate, iFrameInterval);
         device.setRotationListener(this);
+        // the stream must not be closed, it would close the socket
+        PacketWriter writer = new PacketWriter(new FileOutputStream(fd).getChannel(), sendFrameMeta);
+        // the codec is drained independently of the socket writes, so that a slow client does not stall the encoder
+        PacketQueue queue = new PacketQueue(VIDEO_QUEUE_CAPACITY);
+        startWriter(queue, writer);
+        // the codec and the display are kept on restart, only the codec is reconfigured
+        MediaCodec codec = createCodec(videoCodec.getMimeType());
+        IBinder display = createDisplay();
         boolean alive;
         try {
             do {
-                MediaCodec codec = createCodec();
-                IBinder display = createDisplay();
-                Rect contentRect = device.getScreenInfo().getContentRect();
-                Rect videoRect = device.getScreenInfo().getVideoSize().toRect();
-                setSize(format, videoRect.width(), videoRect.height());
+                MediaFormat format = createFormat(videoCodec.getMimeType(), bitRate, frameRate, iFrameInterval);
+                if (frameRateLimited) {
+                    format.setFloat(KEY_MAX_FPS_TO_ENCODER, frameRate);
+                }
+                // read the snapshot once, so that both rects are consistent
+                ScreenInfo screenInfo = device.getScreenInfo();
+                videoSize = screenInfo.getVideoSize();
+                setSize(format, videoSize.getWidth(), videoSize.getHeight());
                 configure(codec, format);
                 Surface surface = codec.createInputSurface();
-                setDisplaySurface(display, surface, contentRect, videoRect);
+                setDisplaySurface(display, surface, screenInfo.getContentRect(), screenInfo.getVideoContentRect());
                 codec.start();
                 try {
-                    alive = encode(codec, fd);
+                    alive = encode(codec, queue, device, display);
                 } finally {
+                    // the display is kept, it must not render to the surface once released; on restart, the new surface and the
+                    // new projection are then set together in a single transaction
+                    detachDisplaySurface(display);
                     codec.stop();
-                    destroyDisplay(display);
-                    codec.release();
                     surface.release();
                 }
+                if (alive) {
+                    awaitResume();
+                }
             } while (alive);
         } finally {
+            destroyDisplay(display);
+            codec.release();
             device.setRotationListener(null);
+            // do not wait for the writer, it may be blocked by the client (it stops on error once the socket is closed)
+            queue.close();
+            Ln.d("Video queue: max " + queue.getMaxSize() + "/" + queue.getCapacity() + " packets, " + queue.getDroppedCount() + " dropped");
+        }
+    }
+
+    private void startWriter(final PacketQueue queue, final PacketWriter writer) {
+        new Thread(new Runnable() {
+            @Override
+            public void run() {
+                try {
+                    PacketQueue.Packet packet;
+                    while ((packet = queue.take()) != null) {
+                        try {
+                            writer.write(packet.getPts(), packet.getData());
+                        } finally {
+                            queue.recycle(packet);
+                        }
+                    }
+                } catch (IOException e) {
+                    // reported to the encoder, which stops on the next packet
+                    writeError = e;
+                } catch (InterruptedException e) {
+                    // stop
+                }
+            }
+        }, "video-writer").start();
+    }
+
+    /**
+     * Handle a pending rotation or region change.
+     *
+     * @return {@code true} if the encoding must restart with the new size
+     */
+    private boolean handleScreenInfoChange(Device device, IBinder display) {
+        if (!consumeScreenInfoChange()) {
+            return false;
+        }
+        ScreenInfo screenInfo = device.getScreenInfo();
+        if (!screenInfo.getVideoSize().equals(videoSize)) {
+            return true;
+        }
+        // the video size is the same (square video rotated, or new region), the codec is kept: only the projection changes
+        setDisplayProjection(display, screenInfo.getContentRect(), screenInfo.getVideoContentRect());
+        return false;
+    }
+
+    /**
+     * Apply the settings requested by the client.
+     *
+     * @return {@code true} if the encoding must restart with the new settings
+     */
+    private boolean handleSettingsChange(MediaCodec codec, Device device) {
+        if (!settingsChanged.getAndSet(false)) {
+            return false;
         }
+        int newBitRate;
+        int newMaxSize;
+        int newFrameRate;
+        synchronized (this) {
+            newBitRate = requestedBitRate;
+            newMaxSize = requestedMaxSize;
+            newFrameRate = requestedFrameRate;
+            requestedBitRate = 0;
+            requestedMaxSize = 0;
+            requestedFrameRate = 0;
+        }
+
+        boolean restart = false;
+        if (newBitRate != 0 && newBitRate != bitRate) {
+            bitRate = newBitRate;
+            // no restart needed
+            Bundle params = new Bundle();
+            params.putInt(MediaCodec.PARAMETER_KEY_VIDEO_BITRATE, bitRate);
+            codec.setParameters(params);
+            Ln.i("Video bit-rate: " + bitRate);
+        }
+        if (newFrameRate != 0 && newFrameRate != frameRate) {
+            frameRate = newFrameRate;
+            frameRateLimited = true;
+            restart = true;
+            Ln.i("Video frame rate: " + frameRate);
+        }
+        if (newMaxSize != 0 && device.setMaxSize(newMaxSize)) {
+            restart = true;
+            Ln.i("Video size: " + device.getScreenInfo().getVideoSize());
+        }
+        return restart;
+    }
+
+    private synchronized void awaitResume() throws IOException {
+        if (!paused) {
+            return;
+        }
+        // the display was detached from the codec surface before it was released (see streamScreen()), so it renders nothing until
+        // the restart attaches a new surface
+        Ln.i("Video paused");
+        try {
+            while (paused) {
+                wait();
+            }
+        } catch (InterruptedException e) {
+            throw new InterruptedIOException("Interrupted while the video is paused");
+        }
+        Ln.i("Video resumed");
     }
 
-    private boolean encode(MediaCodec codec, FileDescriptor fd) throws IOException {
+    private boolean mustRestart(MediaCodec codec, Device device, IBinder display) {
+        // apply both
+        boolean settingsRestart = handleSettingsChange(codec, device);
+        boolean screenInfoRestart = handleScreenInfoChange(device, display);
+        // on pause, the codec is stopped
+        return settingsRestart || screenInfoRestart || paused;
+    }
+
+    private boolean encode(MediaCodec codec, PacketQueue queue, Device device, IBinder display) throws IOException {
         boolean eof = false;
         MediaCodec.BufferInfo bufferInfo = new MediaCodec.BufferInfo();
 
 
-        while (!consumeRotationChange() && !eof) {
+        while (!mustRestart(codec, device, display) && !eof) {
             int outputBufferId = codec.dequeueOutputBuffer(bufferInfo, -1);
             eof = (bufferInfo.flags & MediaCodec.BUFFER_FLAG_END_OF_STREAM) != 0;
             try {
-                if (consumeRotationChange()) {
+                if (mustRestart(codec, device, display)) {
                     // must restart encoding with new size
                     break;
                 }
+                if (writeError != null) {
+                    throw writeError;
+                }
                 if (outputBufferId >= 0) {
                     ByteBuffer codecBuffer = codec.getOutputBuffer(outputBufferId);
-
-                    if (sendFrameMeta) {
-                        writeFrameMeta(fd, bufferInfo, codecBuffer.remaining());
+                    boolean keyFrame = (bufferInfo.flags & MediaCodec.BUFFER_FLAG_KEY_FRAME) != 0;
+                    boolean config = (bufferInfo.flags & MediaCodec.BUFFER_FLAG_CODEC_CONFIG) != 0;
+                    boolean wasDropping = queue.isDropping();
+                    // the packet is copied, so the codec buffer is released without waiting for the socket
+                    queue.offer(codecBuffer, computePts(bufferInfo), keyFrame, config);
+                    if (queue.consumeSyncFrameRequest()) {
+                        Ln.w("Video queue full (" + queue.size() + " packets), dropping until the next key frame");
+                        requestSyncFrame(codec);
+                    } else if (wasDropping && !queue.isDropping()) {
+                        Ln.i("Video stream resumed on key frame (" + queue.getDroppedCount() + " packets dropped in total)");
                     }
-
-                    IO.writeFully(fd, codecBuffer);
                 }
             } finally {
                 if (outputBufferId >= 0) {
@@ -115,32 +337,29 @@ public class ScreenEncoder implements Device.RotationListener {
         return !eof;
     }
 
-    private void writeFrameMeta(FileDescriptor fd, MediaCodec.BufferInfo bufferInfo, int packetSize) throws IOException {
-        headerBuffer.clear();
-
-        long pts;
+    private long computePts(MediaCodec.BufferInfo bufferInfo) {
         if ((bufferInfo.flags & MediaCodec.BUFFER_FLAG_CODEC_CONFIG) != 0) {
-            pts = NO_PTS; // non-media data packet
-        } else {
-            if (ptsOrigin == 0) {
-                ptsOrigin = bufferInfo.presentationTimeUs;
-            }
-            pts = bufferInfo.presentationTimeUs - ptsOrigin;
+            return PacketWriter.NO_PTS; // non-media data packet
         }
+        if (ptsOrigin == 0) {
+            ptsOrigin = bufferInfo.presentationTimeUs;
+        }
+        return bufferInfo.presentationTimeUs - ptsOrigin;
+    }
 
-        headerBuffer.putLong(pts);
-        headerBuffer.putInt(packetSize);
-        headerBuffer.flip();
-        IO.writeFully(fd, headerBuffer);
+    private static void requestSyncFrame(MediaCodec codec) {
+        Bundle params = new Bundle();
+        params.putInt(MediaCodec.PARAMETER_KEY_REQUEST_SYNC_FRAME, 0);
+        codec.setParameters(params);
     }
 
-    private static MediaCodec createCodec() throws IOException {
-        return MediaCodec.createEncoderByType("video/avc");
+    private static MediaCodec createCodec(String mimeType) throws IOException {
+        return MediaCodec.createEncoderByType(mimeType);
     }
 
-    private static MediaFormat createFormat(int bitRate, int frameRate, int iFrameInterval) throws IOException {
+    private static MediaFormat createFormat(String mimeType, int bitRate, int frameRate, int iFrameInterval) throws IOException {
         MediaFormat format = new MediaFormat();
-        format.setString(MediaFormat.KEY_MIME, "video/avc");
+        format.setString(MediaFormat.KEY_MIME, mimeType);
         format.setInteger(MediaFormat.KEY_BIT_RATE, bitRate);
         format.setInteger(MediaFormat.KEY_FRAME_RATE, frameRate);
         format.setInteger(MediaFormat.KEY_COLOR_FORMAT, MediaCodecInfo.CodecCapabilities.COLOR_FormatSurface);
@@ -174,6 +393,24 @@ public class ScreenEncoder implements Device.RotationListener {
         }
     }
 
+    private static void setDisplayProjection(IBinder display, Rect deviceRect, Rect displayRect) {
+        SurfaceControl.openTransaction();
+        try {
+            SurfaceControl.setDisplayProjection(display, 0, deviceRect, displayRect);
+        } finally {
+            SurfaceControl.closeTransaction();
+        }
+    }
+
+    private static void detachDisplaySurface(IBinder display) {
+        SurfaceControl.openTransaction();
+        try {
+            SurfaceControl.setDisplaySurface(display, null);
+        } finally {
+            SurfaceControl.closeTransaction();
+        }
+    }
+
     private static void destroyDisplay(IBinder display) {
         SurfaceControl.destroyDisplay(display);
     }
@@ -1,16 +1,52 @@
 package org.vispo.miralldroid;
 
+import android.graphics.Point;
 import android.graphics.Rect;
 
+/**
+ * Immutable snapshot of the screen geometry, replaced as a whole on rotation.
+ * <p>
+ * It may be read from any thread without locking.
+ */
 public final class ScreenInfo {
-    private final Rect contentRect; // device size, possibly cropped
+    private final Rect contentRect; // device size, possibly cropped (must not be modified)
     private final Size videoSize;
+    // where the content is drawn in the video (smaller than the video if letterboxed, must not be modified)
+    private final Rect videoContentRect;
     private final boolean rotated;
 
+    // transform from video coordinates to device coordinates:
+    // device = offset + (video - videoOffset) * contentSize / videoContentSize
+    private final int offsetX;
+    private final int offsetY;
+    private final int contentWidth;
+    private final int contentHeight;
+    private final int videoOffsetX;
+    private final int videoOffsetY;
+    private final int videoContentWidth;
+    private final int videoContentHeight;
+    private final int videoWidth;
+    private final int videoHeight;
+
     public ScreenInfo(Rect contentRect, Size videoSize, boolean rotated) {
+        this(contentRect, videoSize, videoSize.toRect(), rotated);
+    }
+
+    public ScreenInfo(Rect contentRect, Size videoSize, Rect videoContentRect, boolean rotated) {
         this.contentRect = contentRect;
         this.videoSize = videoSize;
+        this.videoContentRect = videoContentRect;
         this.rotated = rotated;
+        offsetX = contentRect.left;
+        offsetY = contentRect.top;
+        contentWidth = contentRect.width();
+        contentHeight = contentRect.height();
+        videoOffsetX = videoContentRect.left;
+        videoOffsetY = videoContentRect.top;
+        videoContentWidth = videoContentRect.width();
+        videoContentHeight = videoContentRect.height();
+        videoWidth = videoSize.getWidth();
+        videoHeight = videoSize.getHeight();
     }
 
     public Rect getContentRect() {
@@ -21,11 +57,81 @@ public final class ScreenInfo {
         return videoSize;
     }
 
+    public Rect getVideoContentRect() {
+        return videoContentRect;
+    }
+
+    /**
+     * Map a position in the video to the device screen.
+     *
+     * @return the device point, or {@code null} if the position is relative to a video having other dimensions, or is in the
+     * letterbox borders
+     */
+    public Point toDevicePoint(Position position) {
+        Size clientVideoSize = position.getScreenSize();
+        if (clientVideoSize.getWidth() != videoWidth || clientVideoSize.getHeight() != videoHeight) {
+            return null;
+        }
+        int videoX = position.getX() - videoOffsetX;
+        int videoY = position.getY() - videoOffsetY;
+        if (videoX < 0 || videoX >= videoContentWidth || videoY < 0 || videoY >= videoContentHeight) {
+            return null;
+        }
+        int x = offsetX + videoX * contentWidth / videoContentWidth;
+        int y = offsetY + videoY * contentHeight / videoContentHeight;
+        return new Point(x, y);
+    }
+
+    /**
+     * Map a rectangle in the video to the device screen.
+     * <p>
+     * The letterbox borders have no content, so on a letterboxed axis the rectangle is clipped to the video content. On the other
+     * axis, it is kept as is: exceeding the video means capturing more than the current content (to zoom out).
+     *
+     * @param position the top-left corner of the rectangle
+     * @return the device rectangle (possibly outside the content), or {@code null} if the position is relative to a video having
+     * other dimensions, or if the rectangle is entirely in the letterbox borders
+     */
+    public Rect toDeviceRect(Position position, int width, int height) {
+        Size clientVideoSize = position.getScreenSize();
+        if (clientVideoSize.getWidth() != videoWidth || clientVideoSize.getHeight() != videoHeight) {
+            return null;
+        }
+        int videoLeft = position.getX() - videoOffsetX;
+        int videoTop = position.getY() - videoOffsetY;
+        int videoRight = videoLeft + width;
+        int videoBottom = videoTop + height;
+        if (videoContentWidth < videoWidth) {
+            videoLeft = Math.max(videoLeft, 0);
+            videoRight = Math.min(videoRight, videoContentWidth);
+        }
+        if (videoContentHeight < videoHeight) {
+            videoTop = Math.max(videoTop, 0);
+            videoBottom = Math.min(videoBottom, videoContentHeight);
+        }
+        if (videoLeft >= videoRight || videoTop >= videoBottom) {
+            return null;
+        }
+        int left = offsetX + videoLeft * contentWidth / videoContentWidth;
+        int top = offsetY + videoTop * contentHeight / videoContentHeight;
+        int right = offsetX + videoRight * contentWidth / videoContentWidth;
+        int bottom = offsetY + videoBottom * contentHeight / videoContentHeight;
+        return new Rect(left, top, right, bottom);
+    }
+
+    /**
+     * Capture another part of the device screen, drawn at the same place in the video (so that the codec is kept).
+     */
+    public ScreenInfo withContentRect(Rect newContentRect) {
+        return new ScreenInfo(newContentRect, videoSize, videoContentRect, rotated);
+    }
+
     public ScreenInfo withRotation(int rotation) {
         boolean newRotated = (rotation & 1) != 0;
         if (rotated == newRotated) {
             return this;
         }
-        return new ScreenInfo(Device.flipRect(contentRect), videoSize.rotate(), newRotated);
+        // a square video keeps its size, only the letterbox is flipped
+        return new ScreenInfo(Device.flipRect(contentRect), videoSize.rotate(), Device.flipRect(videoContentRect), newRotated);
     }
 }
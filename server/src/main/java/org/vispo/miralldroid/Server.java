@@ -9,23 +9,28 @@ import java.util.Arrays;
 public final class Server {
 
     private static final String SERVER_PATH = "/data/local/tmp/miralldroid-server.jar";
+    private static final String HANDSHAKE_ARG_PREFIX = "handshake=";
 
     private Server() {
         // not instantiable
     }
 
-    private static void miralldroid(Options options) throws IOException {
-        final Device device = new Device(options);
-        boolean tunnelForward = options.isTunnelForward();
-        try (DesktopConnection connection = DesktopConnection.open(device, tunnelForward)) {
-            ScreenEncoder screenEncoder = new ScreenEncoder(options.getSendFrameMeta(), options.getBitRate());
+    private static void miralldroid(Options options, boolean handshake) throws IOException {
+        // with the handshake, the options are received once connected
+        try (DesktopConnection connection = DesktopConnection.open(options, handshake)) {
+            final Device device = new Device(options);
+            // the client needs the codec to initialize its decoder
+            VideoCodec codec = ScreenEncoder.selectCodec(options.getCodec());
+            connection.sendDeviceInfo(device, codec, getCapabilities());
+
+            ScreenEncoder screenEncoder = new ScreenEncoder(options.getSendFrameMeta(), options.getBitRate(), codec);
 
             // asynchronous
-            startEventController(device, connection);
+            startEventController(device, connection, screenEncoder);
 
             try {
                 // synchronous
-                screenEncoder.streamScreen(device, connection.getFd());
+                screenEncoder.streamScreen(device, connection.getVideoFd());
             } catch (IOException e) {
                 // this is expected on close
                 Ln.d("Screen streaming stopped");
@@ -33,24 +38,53 @@ public final class Server {
         }
     }
 
-    private static void startEventController(final Device device, final DesktopConnection connection) {
+    private static void startEventController(final Device device, final DesktopConnection connection, final ScreenEncoder screenEncoder) {
         new Thread(new Runnable() {
             @Override
             public void run() {
                 try {
-                    new EventController(device, connection).control();
+                    new EventController(device, connection, screenEncoder).control();
                 } catch (IOException e) {
                     // this is expected on close
                     Ln.d("Event controller stopped");
+                    // if the video is paused, resume it, so that the streaming fails on the next write and stops
+                    screenEncoder.setPaused(false);
                 }
             }
         }).start();
     }
 
+    private static int getCapabilities() {
+        int capabilities = Handshake.CAPABILITY_REGION | Handshake.CAPABILITY_PAUSE_VIDEO;
+        if (ScreenEncoder.hasEncoder(VideoCodec.H265.getMimeType())) {
+            capabilities |= Handshake.CAPABILITY_H265_ENCODER;
+        }
+        return capabilities;
+    }
+
+    static boolean isHandshake(String... args) {
+        // the version actually used is negotiated in the handshake
+        return args.length == 2 && args[0].startsWith(HANDSHAKE_ARG_PREFIX);
+    }
+
+    static Options createHandshakeOptions(String... args) {
+        int version = Integer.parseInt(args[0].substring(HANDSHAKE_ARG_PREFIX.length()));
+        if (version < 1) {
+            throw new IllegalArgumentException("Invalid handshake version: " + version);
+        }
+
+        // the other options are received in the handshake
+        Options options = new Options();
+        boolean tunnelForward = Boolean.parseBoolean(args[1]);
+        options.setTunnelForward(tunnelForward);
+        return options;
+    }
+
+    // the positional arguments of the clients not supporting the handshake
     @SuppressWarnings("checkstyle:MagicNumber")
-    private static Options createOptions(String... args) {
+    static Options createLegacyOptions(String... args) {
         if (args.length != 5)
-            throw new IllegalArgumentException("Expecting 5 parameters");
+            throw new IllegalArgumentException("Expecting 5 parameters, or \"" + HANDSHAKE_ARG_PREFIX + "<version>\" and the tunnel mode");
 
         Options options = new Options();
 
@@ -70,10 +104,15 @@ public final class Server {
         boolean sendFrameMeta = Boolean.parseBoolean(args[4]);
         options.setSendFrameMeta(sendFrameMeta);
 
+        // the only ones supported by these clients
+        options.setControlProtocolVersion(ControlEventReader.PROTOCOL_VERSION_1);
+        options.setSquareVideo(false);
+        options.setCodec(VideoCodec.H264);
+
         return options;
     }
 
-    private static Rect parseCrop(String crop) {
+    static Rect parseCrop(String crop) {
         if ("-".equals(crop)) {
             return null;
         }
@@ -106,7 +145,8 @@ public final class Server {
         });
 
         unlinkSelf();
-        Options options = createOptions(args);
-        miralldroid(options);
+        boolean handshake = isHandshake(args);
+        Options options = handshake ? createHandshakeOptions(args) : createLegacyOptions(args);
+        miralldroid(options, handshake);
     }
 }
@@ -0,0 +1,49 @@
+package org.vispo.miralldroid;
+
+public enum VideoCodec {
+    H264(0, "h264", "video/avc"),
+    H265(1, "h265", "video/hevc");
+
+    private final int id; // sent to the client in the device info
+    private final String name; // as passed to the client "--codec" option
+    private final String mimeType;
+
+    VideoCodec(int id, String name, String mimeType) {
+        this.id = id;
+        this.name = name;
+        this.mimeType = mimeType;
+    }
+
+    public int getId() {
+        return id;
+    }
+
+    public String getName() {
+        return name;
+    }
+
+    public String getMimeType() {
+        return mimeType;
+    }
+
+    public static VideoCodec findByName(String name) {
+        for (VideoCodec codec : values()) {
+            if (codec.name.equals(name)) {
+                return codec;
+            }
+        }
+        throw new IllegalArgumentException("Unknown video codec: " + name);
+    }
+
+    /**
+     * Return the codec having the given id, or {@code null} if it is unknown.
+     */
+    public static VideoCodec findById(int id) {
+        for (VideoCodec codec : values()) {
+            if (codec.id == id) {
+                return codec;
+            }
+        }
+        return null;
+    }
+}
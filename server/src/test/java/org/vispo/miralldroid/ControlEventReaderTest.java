@@ -16,6 +16,18 @@ import java.util.Arrays;
 
 public class ControlEventReaderTest {
 
+    // same bytes as test_serialize_v2_events() in the client tests
+    private static final byte[] V2_EVENTS = {
+        // mouse down
+        0x12, (byte) 0xd0, 0x0f, 0x00, 0x01, (byte) 0xb8, 0x08, (byte) 0x80, 0x0f, (byte) 0x88, 0x04, (byte) 0x84, 0x10,
+        // mouse move, same screen size
+        0x02, 0x20, 0x02, 0x01, 0x03, 0x08,
+        // keycode
+        0x00, 0x0b, 0x00, 0x42, 0x00,
+        // text
+        0x01, 0x00, 0x02, 'h', 'i',
+    };
+
     @Test
     public void testParseKeycodeEvent() throws IOException {
         ControlEventReader reader = new ControlEventReader();
@@ -97,6 +109,51 @@ public class ControlEventReaderTest {
         Assert.assertEquals(KeyEvent.META_CTRL_ON, event.getMetaState());
     }
 
+    @Test
+    public void testParseVideoEvent() throws IOException {
+        ControlEventReader reader = new ControlEventReader();
+
+        ByteArrayOutputStream bos = new ByteArrayOutputStream();
+        DataOutputStream dos = new DataOutputStream(bos);
+        dos.writeByte(ControlEvent.TYPE_VIDEO);
+        dos.writeInt(4000000);
+        dos.writeShort(1024);
+        dos.writeShort(0);
+
+        byte[] packet = bos.toByteArray();
+        reader.readFrom(new ByteArrayInputStream(packet));
+        ControlEvent event = reader.next();
+
+        Assert.assertEquals(ControlEvent.TYPE_VIDEO, event.getType());
+        Assert.assertEquals(4000000, event.getBitRate());
+        Assert.assertEquals(1024, event.getMaxSize());
+        Assert.assertEquals(0, event.getFrameRate());
+    }
+
+    @Test
+    public void testParseRegionEvent() throws IOException {
+        ControlEventReader reader = new ControlEventReader();
+
+        ByteArrayOutputStream bos = new ByteArrayOutputStream();
+        DataOutputStream dos = new DataOutputStream(bos);
+        dos.writeByte(ControlEvent.TYPE_REGION);
+        dos.writeInt(-270);
+        dos.writeInt(480);
+        dos.writeShort(1080);
+        dos.writeShort(1920);
+        dos.writeShort(540);
+        dos.writeShort(960);
+
+        byte[] packet = bos.toByteArray();
+        reader.readFrom(new ByteArrayInputStream(packet));
+        ControlEvent event = reader.next();
+
+        Assert.assertEquals(ControlEvent.TYPE_REGION, event.getType());
+        Assert.assertEquals(new Position(-270, 480, 1080, 1920), event.getPosition());
+        Assert.assertEquals(540, event.getWidth());
+        Assert.assertEquals(960, event.getHeight());
+    }
+
     @Test
     public void testMultiEvents() throws IOException {
         ControlEventReader reader = new ControlEventReader();
@@ -170,4 +227,142 @@ public class ControlEventReaderTest {
         Assert.assertEquals(MotionEvent.BUTTON_PRIMARY, event.getKeycode());
         Assert.assertEquals(KeyEvent.META_CTRL_ON, event.getMetaState());
     }
+
+    @Test
+    public void testPartialTextEventLength() throws IOException {
+        ControlEventReader reader = new ControlEventReader();
+
+        ByteArrayOutputStream bos = new ByteArrayOutputStream();
+        DataOutputStream dos = new DataOutputStream(bos);
+
+        // a batch of events may be split anywhere, even inside the text length
+        dos.writeByte(ControlEvent.TYPE_TEXT);
+        dos.writeByte(0);
+
+        byte[] packet = bos.toByteArray();
+        reader.readFrom(new ByteArrayInputStream(packet));
+
+        ControlEvent event = reader.next();
+        Assert.assertNull(event); // the event is not complete
+
+        bos.reset();
+        dos.writeByte(5);
+        dos.write("hello".getBytes(StandardCharsets.UTF_8));
+        packet = bos.toByteArray();
+        reader.readFrom(new ByteArrayInputStream(packet));
+
+        event = reader.next();
+        Assert.assertEquals(ControlEvent.TYPE_TEXT, event.getType());
+        Assert.assertEquals("hello", event.getText());
+    }
+
+    @Test
+    public void testParseV2Events() throws IOException {
+        ControlEventReader reader = new ControlEventReader(ControlEventReader.PROTOCOL_VERSION_2);
+        reader.readFrom(new ByteArrayInputStream(V2_EVENTS));
+
+        ControlEvent event = reader.next();
+        Assert.assertEquals(ControlEvent.TYPE_MOUSE, event.getType());
+        Assert.assertEquals(MotionEvent.ACTION_DOWN, event.getAction());
+        Assert.assertEquals(MotionEvent.BUTTON_PRIMARY, event.getButtons());
+        Assert.assertEquals(new Position(260, 1026, 1080, 1920), event.getPosition());
+        Assert.assertEquals(1000, event.getTimestamp());
+
+        event = reader.next();
+        Assert.assertEquals(ControlEvent.TYPE_MOUSE, event.getType());
+        Assert.assertEquals(MotionEvent.ACTION_MOVE, event.getAction());
+        Assert.assertEquals(new Position(258, 1030, 1080, 1920), event.getPosition());
+        Assert.assertEquals(1016, event.getTimestamp());
+
+        event = reader.next();
+        Assert.assertEquals(ControlEvent.TYPE_KEYCODE, event.getType());
+        Assert.assertEquals(KeyEvent.ACTION_DOWN, event.getAction());
+        Assert.assertEquals(KeyEvent.KEYCODE_ENTER, event.getKeycode());
+        Assert.assertEquals(0, event.getMetaState());
+        Assert.assertEquals(1010, event.getTimestamp());
+
+        event = reader.next();
+        Assert.assertEquals(ControlEvent.TYPE_TEXT, event.getType());
+        Assert.assertEquals("hi", event.getText());
+        Assert.assertEquals(1010, event.getTimestamp());
+
+        Assert.assertNull(reader.next());
+    }
+
+    @Test
+    public void testParseV2PartialEvents() throws IOException {
+        ControlEventReader reader = new ControlEventReader(ControlEventReader.PROTOCOL_VERSION_2);
+
+        // split in the middle of the move, the deltas must not be applied twice
+        int split = 16;
+        reader.readFrom(new ByteArrayInputStream(Arrays.copyOfRange(V2_EVENTS, 0, split)));
+
+        ControlEvent event = reader.next();
+        Assert.assertEquals(new Position(260, 1026, 1080, 1920), event.getPosition());
+
+        event = reader.next();
+        Assert.assertNull(event); // the event is not complete
+
+        reader.readFrom(new ByteArrayInputStream(Arrays.copyOfRange(V2_EVENTS, split, V2_EVENTS.length)));
+
+        event = reader.next();
+        Assert.assertEquals(ControlEvent.TYPE_MOUSE, event.getType());
+        Assert.assertEquals(new Position(258, 1030, 1080, 1920), event.getPosition());
+        Assert.assertEquals(1016, event.getTimestamp());
+    }
+
+    @Test
+    public void testEventInstanceIsReused() throws IOException {
+        ControlEventReader reader = new ControlEventReader(ControlEventReader.PROTOCOL_VERSION_2);
+        reader.readFrom(new ByteArrayInputStream(V2_EVENTS));
+
+        ControlEvent first = reader.next();
+        Position position = first.getPosition();
+        ControlEvent second = reader.next();
+        Assert.assertSame(first, second);
+        Assert.assertSame(position, second.getPosition());
+        Assert.assertEquals(new Position(258, 1030, 1080, 1920), second.getPosition());
+
+        // the fields of the previous event must not leak into the next one
+        ControlEvent third = reader.next();
+        Assert.assertEquals(ControlEvent.TYPE_KEYCODE, third.getType());
+        Assert.assertNull(third.getPosition());
+        Assert.assertEquals(0, third.getButtons());
+    }
+
+    // not a real benchmark, but enough to compare the parsing cost between changes
+    @Test
+    public void benchmarkParseMouseEvents() throws IOException {
+        final int count = 200000;
+        ByteArrayOutputStream bos = new ByteArrayOutputStream();
+        DataOutputStream dos = new DataOutputStream(bos);
+        for (int i = 0; i < count; ++i) {
+            dos.writeByte(ControlEvent.TYPE_MOUSE);
+            dos.writeByte(MotionEvent.ACTION_MOVE);
+            dos.writeInt(MotionEvent.BUTTON_PRIMARY);
+            dos.writeInt(i % 1080);
+            dos.writeInt(i % 1920);
+            dos.writeShort(1080);
+            dos.writeShort(1920);
+        }
+        byte[] packet = bos.toByteArray();
+
+        // the first run warms up the JIT
+        long elapsed = 0;
+        for (int run = 0; run < 2; ++run) {
+            ControlEventReader reader = new ControlEventReader();
+            ByteArrayInputStream input = new ByteArrayInputStream(packet);
+            int parsed = 0;
+            long start = System.nanoTime();
+            while (parsed < count) {
+                reader.readFrom(input);
+                while (reader.next() != null) {
+                    ++parsed;
+                }
+            }
+            elapsed = System.nanoTime() - start;
+            Assert.assertEquals(count, parsed);
+        }
+        System.out.println("ControlEventReader: " + (elapsed / count) + " ns/event");
+    }
 }
@@ -0,0 +1,27 @@
+package org.vispo.miralldroid;
+
+import org.junit.Assert;
+import org.junit.Test;
+
+public class DeviceTest {
+
+    @Test
+    public void testFitAspectRatioLetterboxed() {
+        // a 1080x1920 device letterboxed in a 1920x1920 video: zooming in requests half of the video, which maps to a 960x960
+        // device region; it must grow to the 1080x1920 aspect ratio of the video content, not be stretched into it
+        Size size = Device.fitAspectRatio(new Size(960, 960), new Size(1080, 1920));
+        Assert.assertEquals(new Size(960, 1707), size);
+    }
+
+    @Test
+    public void testFitAspectRatioTooTall() {
+        Size size = Device.fitAspectRatio(new Size(100, 400), new Size(1920, 1080));
+        Assert.assertEquals(new Size(712, 400), size);
+    }
+
+    @Test
+    public void testFitAspectRatioUnchanged() {
+        Size size = Device.fitAspectRatio(new Size(540, 960), new Size(1080, 1920));
+        Assert.assertEquals(new Size(540, 960), size);
+    }
+}
@@ -0,0 +1,186 @@
+package org.vispo.miralldroid;
+
+import org.junit.Assert;
+import org.junit.Test;
+
+import java.io.ByteArrayInputStream;
+import java.io.IOException;
+import java.nio.ByteBuffer;
+
+public class HandshakeTest {
+
+    // same bytes as test_serialize_options_no_crop() in the client tests
+    private static final byte[] OPTIONS = {
+        // header: version 1, payload length 28
+        0x01, 0x00, 0x1c,
+        // max size: 0
+        0x01, 0x00, 0x02, 0x00, 0x00,
+        // bit rate: 8000000
+        0x02, 0x00, 0x04, 0x00, 0x7a, 0x12, 0x00,
+        // no frame meta
+        0x04, 0x00, 0x01, 0x00,
+        // control protocol version 2
+        0x05, 0x00, 0x01, 0x02,
+        // square video
+        0x06, 0x00, 0x01, 0x01,
+        // codec: H.264
+        0x07, 0x00, 0x01, 0x00,
+    };
+
+    // same bytes as test_parse_device_info() in the client tests, with the header
+    private static final byte[] DEVICE_INFO = {
+        // header: version 1, payload length 32
+        0x01, 0x00, 0x20,
+        // device name
+        0x01, 0x00, 0x07, 'P', 'i', 'x', 'e', 'l', ' ', '3',
+        // video size: 1080x2160
+        0x02, 0x00, 0x04, 0x04, 0x38, 0x08, 0x70,
+        // codec: H.265
+        0x03, 0x00, 0x01, 0x01,
+        // control protocol version 2
+        0x04, 0x00, 0x01, 0x02,
+        // capabilities
+        0x05, 0x00, 0x04, 0x00, 0x00, 0x00, 0x07,
+    };
+
+    @Test
+    public void testReadOptions() throws IOException {
+        Options options = new Options();
+        options.setTunnelForward(true);
+
+        // followed by a control event, which must not be consumed
+        byte[] data = new byte[OPTIONS.length + 1];
+        System.arraycopy(OPTIONS, 0, data, 0, OPTIONS.length);
+        data[OPTIONS.length] = (byte) ControlEvent.TYPE_COMMAND;
+        ByteArrayInputStream input = new ByteArrayInputStream(data);
+        int version = Handshake.readOptions(input, options);
+
+        Assert.assertEquals(1, version);
+        Assert.assertEquals(1, input.available());
+        Assert.assertEquals(0, options.getMaxSize());
+        Assert.assertEquals(8000000, options.getBitRate());
+        Assert.assertNull(options.getCrop());
+        Assert.assertFalse(options.getSendFrameMeta());
+        Assert.assertEquals(ControlEventReader.PROTOCOL_VERSION_2, options.getControlProtocolVersion());
+        Assert.assertTrue(options.getSquareVideo());
+        Assert.assertEquals(VideoCodec.H264, options.getCodec());
+        // not part of the handshake
+        Assert.assertTrue(options.isTunnelForward());
+    }
+
+    @Test
+    public void testReadOptionsFromMoreRecentClient() throws IOException {
+        byte[] data = OPTIONS.clone();
+        data[0] = 0x02;
+        Options options = new Options();
+        int version = Handshake.readOptions(new ByteArrayInputStream(data), options);
+
+        Assert.assertEquals(2, version);
+        Assert.assertEquals(8000000, options.getBitRate());
+        // answered with the version of the server
+        Assert.assertEquals(1, Handshake.negotiateVersion(version));
+    }
+
+    @Test
+    public void testNegotiateVersion() {
+        Assert.assertEquals(1, Handshake.negotiateVersion(1));
+        Assert.assertEquals(Handshake.VERSION, Handshake.negotiateVersion(Handshake.VERSION + 1));
+    }
+
+    @Test
+    public void testParseOptionsDefaultsAndUnknownEntries() throws IOException {
+        byte[] payload = {
+            // max size: 1023, rounded to a multiple of 8
+            0x01, 0x00, 0x02, 0x03, (byte) 0xff,
+            // unknown entry, to be skipped
+            0x2a, 0x00, 0x03, 0x01, 0x02, 0x03,
+            // control protocol version 9, not supported yet
+            0x05, 0x00, 0x01, 0x09,
+            // unknown codec
+            0x07, 0x00, 0x01, 0x09,
+        };
+
+        Options options = new Options();
+        Handshake.parseOptions(ByteBuffer.wrap(payload), options);
+
+        Assert.assertEquals(1016, options.getMaxSize());
+        Assert.assertEquals(8000000, options.getBitRate());
+        Assert.assertFalse(options.getSendFrameMeta());
+        Assert.assertEquals(ControlEventReader.PROTOCOL_VERSION_2, options.getControlProtocolVersion());
+        Assert.assertFalse(options.getSquareVideo());
+        Assert.assertEquals(VideoCodec.H264, options.getCodec());
+    }
+
+    @Test(expected = IOException.class)
+    public void testParseTruncatedOption() throws IOException {
+        byte[] payload = {0x02, 0x00, 0x04, 0x00, 0x7a, 0x12};
+        Handshake.parseOptions(ByteBuffer.wrap(payload), new Options());
+    }
+
+    @Test(expected = IOException.class)
+    public void testParseOptionWithWrongLength() throws IOException {
+        byte[] payload = {0x04, 0x00, 0x02, 0x00, 0x01};
+        Handshake.parseOptions(ByteBuffer.wrap(payload), new Options());
+    }
+
+    @Test
+    public void testParseHeader() throws IOException {
+        Assert.assertEquals(258, Handshake.parseHeader(new byte[] {0x01, 0x01, 0x02}));
+    }
+
+    @Test
+    public void testParseHeaderMoreRecentVersion() throws IOException {
+        Assert.assertEquals(16, Handshake.parseHeader(new byte[] {0x02, 0x00, 0x10}));
+    }
+
+    @Test(expected = IOException.class)
+    public void testParseHeaderInvalidVersion() throws IOException {
+        Handshake.parseHeader(new byte[] {0x00, 0x00, 0x10});
+    }
+
+    @Test(expected = IOException.class)
+    public void testParseHeaderTooLong() throws IOException {
+        Handshake.parseHeader(new byte[] {0x01, (byte) 0xff, (byte) 0xff});
+    }
+
+    @Test
+    public void testSerializeDeviceInfo() {
+        int capabilities = Handshake.CAPABILITY_H265_ENCODER | Handshake.CAPABILITY_REGION | Handshake.CAPABILITY_PAUSE_VIDEO;
+        byte[] hello = Handshake.serializeDeviceInfo(1, "Pixel 3", new Size(1080, 2160), VideoCodec.H265,
+                ControlEventReader.PROTOCOL_VERSION_2, capabilities);
+        Assert.assertArrayEquals(DEVICE_INFO, hello);
+    }
+
+    @Test
+    public void testSerializeDeviceInfoLongName() throws IOException {
+        StringBuilder builder = new StringBuilder();
+        for (int i = 0; i < 100; ++i) {
+            builder.append('a');
+        }
+        byte[] hello = Handshake.serializeDeviceInfo(1, builder.toString(), new Size(16, 32), VideoCodec.H264,
+                ControlEventReader.PROTOCOL_VERSION_1, 0);
+
+        int payloadLength = Handshake.parseHeader(hello);
+        Assert.assertEquals(hello.length - Handshake.HEADER_LENGTH, payloadLength);
+        // the name is truncated to fit in the client buffer (64 bytes, including '\0')
+        Assert.assertEquals(0x01, hello[3]);
+        Assert.assertEquals(0x00, hello[4]);
+        Assert.assertEquals(63, hello[5]);
+    }
+
+    @Test
+    public void testSerializeLegacyDeviceInfo() {
+        byte[] info = Handshake.serializeLegacyDeviceInfo("Pixel 3", new Size(1080, 2160));
+
+        Assert.assertEquals(Handshake.LEGACY_DEVICE_INFO_LENGTH, info.length);
+        byte[] name = {'P', 'i', 'x', 'e', 'l', ' ', '3', 0};
+        for (int i = 0; i < name.length; ++i) {
+            Assert.assertEquals(name[i], info[i]);
+        }
+        // video size: 1080x2160
+        Assert.assertEquals(0x04, info[64]);
+        Assert.assertEquals(0x38, info[65]);
+        Assert.assertEquals(0x08, info[66]);
+        Assert.assertEquals(0x70, info[67]);
+    }
+}
@@ -0,0 +1,150 @@
+package org.vispo.miralldroid;
+
+import android.view.KeyEvent;
+import android.view.MotionEvent;
+
+import org.junit.Assert;
+import org.junit.Test;
+
+import java.io.ByteArrayInputStream;
+import java.io.ByteArrayOutputStream;
+import java.io.IOException;
+
+public class MotionBatchTest {
+
+    private static final int SCREEN_WIDTH = 1080;
+    private static final int SCREEN_HEIGHT = 1920;
+
+    // write events using the protocol v2, which carries the client timestamps
+    private static class EventWriter {
+        private final ByteArrayOutputStream bos = new ByteArrayOutputStream();
+        private boolean screenSizeSent;
+
+        private void writeUVarint(int value) {
+            while ((value & ~0x7f) != 0) {
+                bos.write((value & 0x7f) | 0x80);
+                value >>>= 7;
+            }
+            bos.write(value);
+        }
+
+        private void writeVarint(int value) {
+            writeUVarint((value << 1) ^ (value >> 31));
+        }
+
+        void writeMouse(int action, int buttons, int timestampDelta, int dx, int dy) {
+            int header = ControlEvent.TYPE_MOUSE;
+            if (!screenSizeSent) {
+                header |= 0x10;
+            }
+            bos.write(header);
+            writeVarint(timestampDelta);
+            bos.write(action);
+            writeUVarint(buttons);
+            if (!screenSizeSent) {
+                writeUVarint(SCREEN_WIDTH);
+                writeUVarint(SCREEN_HEIGHT);
+                screenSizeSent = true;
+            }
+            writeVarint(dx);
+            writeVarint(dy);
+        }
+
+        void writeKeycode(int action, int keycode) {
+            bos.write(ControlEvent.TYPE_KEYCODE);
+            writeVarint(0);
+            bos.write(action);
+            writeUVarint(keycode);
+            writeUVarint(0);
+        }
+
+        ControlEventReader toReader() throws IOException {
+            ControlEventReader reader = new ControlEventReader(ControlEventReader.PROTOCOL_VERSION_2);
+            reader.readFrom(new ByteArrayInputStream(bos.toByteArray()));
+            return reader;
+        }
+    }
+
+    @Test
+    public void testGroupConsecutiveMoves() throws IOException {
+        EventWriter writer = new EventWriter();
+        writer.writeMouse(MotionEvent.ACTION_DOWN, MotionEvent.BUTTON_PRIMARY, 100, 10, 10);
+        writer.writeMouse(MotionEvent.ACTION_MOVE, MotionEvent.BUTTON_PRIMARY, 8, 1, 2);
+        writer.writeMouse(MotionEvent.ACTION_MOVE, MotionEvent.BUTTON_PRIMARY, 8, 3, 4);
+        writer.writeMouse(MotionEvent.ACTION_MOVE, MotionEvent.BUTTON_PRIMARY, 8, 5, 6);
+        writer.writeMouse(MotionEvent.ACTION_UP, MotionEvent.BUTTON_PRIMARY, 8, 0, 0);
+        ControlEventReader reader = writer.toReader();
+
+        ControlEvent event = reader.next();
+        Assert.assertEquals(MotionEvent.ACTION_DOWN, event.getAction());
+
+        MotionBatch batch = new MotionBatch();
+        batch.start(reader.next());
+        ControlEvent remaining = batch.fill(reader);
+
+        Assert.assertEquals(3, batch.size());
+        Assert.assertEquals(MotionEvent.BUTTON_PRIMARY, batch.getButtons());
+        Assert.assertEquals(new Position(11, 12, SCREEN_WIDTH, SCREEN_HEIGHT), batch.getPosition(0));
+        Assert.assertEquals(new Position(14, 16, SCREEN_WIDTH, SCREEN_HEIGHT), batch.getPosition(1));
+        Assert.assertEquals(new Position(19, 22, SCREEN_WIDTH, SCREEN_HEIGHT), batch.getPosition(2));
+        Assert.assertEquals(108, batch.getTimestamp(0));
+        Assert.assertEquals(124, batch.getTimestamp(2));
+
+        // the button release is not part of the batch, it must be handled after
+        Assert.assertEquals(ControlEvent.TYPE_MOUSE, remaining.getType());
+        Assert.assertEquals(MotionEvent.ACTION_UP, remaining.getAction());
+        Assert.assertNull(reader.next());
+    }
+
+    @Test
+    public void testBatchStopsOnOtherEvents() throws IOException {
+        EventWriter writer = new EventWriter();
+        writer.writeMouse(MotionEvent.ACTION_MOVE, MotionEvent.BUTTON_PRIMARY, 100, 10, 10);
+        writer.writeKeycode(KeyEvent.ACTION_DOWN, KeyEvent.KEYCODE_BACK);
+        writer.writeMouse(MotionEvent.ACTION_MOVE, MotionEvent.BUTTON_PRIMARY, 8, 1, 1);
+        writer.writeMouse(MotionEvent.ACTION_MOVE, MotionEvent.BUTTON_SECONDARY, 8, 1, 1);
+        ControlEventReader reader = writer.toReader();
+
+        MotionBatch batch = new MotionBatch();
+        batch.start(reader.next());
+        ControlEvent remaining = batch.fill(reader);
+        Assert.assertEquals(1, batch.size());
+        Assert.assertEquals(ControlEvent.TYPE_KEYCODE, remaining.getType());
+
+        batch.start(reader.next());
+        remaining = batch.fill(reader);
+        // other buttons, not grouped
+        Assert.assertEquals(1, batch.size());
+        Assert.assertEquals(MotionEvent.BUTTON_SECONDARY, remaining.getButtons());
+    }
+
+    @Test
+    public void testBatchRequiresIncreasingTimestamps() throws IOException {
+        EventWriter writer = new EventWriter();
+        writer.writeMouse(MotionEvent.ACTION_MOVE, MotionEvent.BUTTON_PRIMARY, 100, 10, 10);
+        writer.writeMouse(MotionEvent.ACTION_MOVE, MotionEvent.BUTTON_PRIMARY, 0, 1, 1);
+        ControlEventReader reader = writer.toReader();
+
+        MotionBatch batch = new MotionBatch();
+        batch.start(reader.next());
+        ControlEvent remaining = batch.fill(reader);
+        Assert.assertEquals(1, batch.size());
+        Assert.assertEquals(MotionEvent.ACTION_MOVE, remaining.getAction());
+    }
+
+    @Test
+    public void testBatchMaxSize() throws IOException {
+        EventWriter writer = new EventWriter();
+        for (int i = 0; i < MotionBatch.MAX_SIZE + 1; ++i) {
+            writer.writeMouse(MotionEvent.ACTION_MOVE, MotionEvent.BUTTON_PRIMARY, 1, 1, 1);
+        }
+        ControlEventReader reader = writer.toReader();
+
+        MotionBatch batch = new MotionBatch();
+        batch.start(reader.next());
+        ControlEvent remaining = batch.fill(reader);
+        Assert.assertEquals(MotionBatch.MAX_SIZE, batch.size());
+        Assert.assertNotNull(remaining);
+        Assert.assertNull(reader.next());
+    }
+}
@@ -0,0 +1,79 @@
+package org.vispo.miralldroid;
+
+import org.junit.Assert;
+import org.junit.Test;
+
+import java.nio.ByteBuffer;
+
+public class PacketQueueTest {
+
+    private static ByteBuffer packet(int value) {
+        return ByteBuffer.wrap(new byte[] {(byte) value, 0x42});
+    }
+
+    @Test
+    public void testQueuePackets() throws InterruptedException {
+        PacketQueue queue = new PacketQueue(4);
+        ByteBuffer data = packet(1);
+        Assert.assertTrue(queue.offer(data, 100, true, false));
+        // the data is copied
+        Assert.assertFalse(data.hasRemaining());
+        Assert.assertTrue(queue.offer(packet(2), 200, false, false));
+        Assert.assertEquals(2, queue.size());
+
+        PacketQueue.Packet p = queue.take();
+        Assert.assertEquals(100, p.getPts());
+        Assert.assertEquals(1, p.getData().get(0));
+        Assert.assertEquals(2, p.getData().remaining());
+        queue.recycle(p);
+
+        p = queue.take();
+        Assert.assertEquals(200, p.getPts());
+        Assert.assertEquals(2, p.getData().get(0));
+        queue.recycle(p);
+
+        queue.close();
+        Assert.assertNull(queue.take());
+    }
+
+    @Test
+    public void testDropUntilKeyFrame() throws InterruptedException {
+        PacketQueue queue = new PacketQueue(2);
+        Assert.assertTrue(queue.offer(packet(1), 0, true, false));
+        Assert.assertTrue(queue.offer(packet(2), 1, false, false));
+
+        // the pool is exhausted
+        Assert.assertFalse(queue.offer(packet(3), 2, false, false));
+        Assert.assertTrue(queue.isDropping());
+        Assert.assertTrue(queue.consumeSyncFrameRequest());
+        Assert.assertFalse(queue.consumeSyncFrameRequest());
+
+        // the writer consumes the queue, but the rest of the GOP is still dropped
+        queue.recycle(queue.take());
+        queue.recycle(queue.take());
+        Assert.assertFalse(queue.offer(packet(4), 3, false, false));
+        Assert.assertFalse(queue.consumeSyncFrameRequest());
+
+        // the config is never dropped
+        Assert.assertTrue(queue.offer(packet(5), PacketWriter.NO_PTS, false, true));
+
+        // resume on key frame
+        Assert.assertTrue(queue.offer(packet(6), 4, true, false));
+        Assert.assertFalse(queue.isDropping());
+        Assert.assertEquals(2, queue.getDroppedCount());
+        Assert.assertEquals(2, queue.getMaxSize());
+
+        Assert.assertEquals(5, queue.take().getData().get(0));
+        Assert.assertEquals(6, queue.take().getData().get(0));
+    }
+
+    @Test
+    public void testConfigWhenFull() throws InterruptedException {
+        PacketQueue queue = new PacketQueue(1);
+        Assert.assertTrue(queue.offer(packet(1), 0, true, false));
+        // a packet is allocated outside the pool for the config
+        Assert.assertTrue(queue.offer(packet(2), PacketWriter.NO_PTS, false, true));
+        Assert.assertFalse(queue.isDropping());
+        Assert.assertEquals(2, queue.size());
+    }
+}
@@ -0,0 +1,74 @@
+package org.vispo.miralldroid;
+
+import org.junit.Assert;
+import org.junit.Test;
+
+import java.io.IOException;
+import java.nio.ByteBuffer;
+import java.nio.channels.Pipe;
+
+public class PacketWriterTest {
+
+    private static ByteBuffer readFully(Pipe.SourceChannel source, int len) throws IOException {
+        ByteBuffer buffer = ByteBuffer.allocate(len);
+        while (buffer.hasRemaining()) {
+            if (source.read(buffer) == -1) {
+                break;
+            }
+        }
+        buffer.flip();
+        return buffer;
+    }
+
+    @Test
+    public void testWritePacketsWithMeta() throws IOException {
+        Pipe pipe = Pipe.open();
+        PacketWriter writer = new PacketWriter(pipe.sink(), true);
+
+        byte[] config = {0x00, 0x00, 0x00, 0x01, 0x67};
+        byte[] frame = {0x00, 0x00, 0x00, 0x01, 0x65, 0x42, 0x43};
+        // the payload is written from its position
+        ByteBuffer framePayload = ByteBuffer.allocate(frame.length + 2);
+        framePayload.position(2);
+        framePayload.put(frame);
+        framePayload.position(2);
+
+        writer.write(PacketWriter.NO_PTS, ByteBuffer.wrap(config));
+        writer.write(16666, framePayload);
+        Assert.assertFalse(framePayload.hasRemaining());
+
+        int total = 2 * PacketWriter.HEADER_LENGTH + config.length + frame.length;
+        ByteBuffer data = readFully(pipe.source(), total);
+        Assert.assertEquals(total, data.remaining());
+
+        Assert.assertEquals(PacketWriter.NO_PTS, data.getLong());
+        Assert.assertEquals(config.length, data.getInt());
+        byte[] payload = new byte[config.length];
+        data.get(payload);
+        Assert.assertArrayEquals(config, payload);
+
+        Assert.assertEquals(16666, data.getLong());
+        Assert.assertEquals(frame.length, data.getInt());
+        payload = new byte[frame.length];
+        data.get(payload);
+        Assert.assertArrayEquals(frame, payload);
+    }
+
+    @Test
+    public void testWritePacketsWithoutMeta() throws IOException {
+        Pipe pipe = Pipe.open();
+        PacketWriter writer = new PacketWriter(pipe.sink(), false);
+
+        byte[] frame = {0x00, 0x00, 0x00, 0x01, 0x65, 0x42, 0x43};
+        writer.write(42, ByteBuffer.wrap(frame));
+        writer.write(43, ByteBuffer.wrap(frame));
+
+        ByteBuffer data = readFully(pipe.source(), 2 * frame.length);
+        byte[] raw = new byte[data.remaining()];
+        data.get(raw);
+        byte[] expected = new byte[2 * frame.length];
+        System.arraycopy(frame, 0, expected, 0, frame.length);
+        System.arraycopy(frame, 0, expected, frame.length, frame.length);
+        Assert.assertArrayEquals(expected, raw);
+    }
+}
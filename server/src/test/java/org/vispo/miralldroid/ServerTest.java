@@ -0,0 +1,53 @@
+package org.vispo.miralldroid;
+
+import org.junit.Assert;
+import org.junit.Test;
+
+public class ServerTest {
+
+    @Test
+    public void testCreateHandshakeOptions() {
+        String[] args = {"handshake=1", "true"};
+        Assert.assertTrue(Server.isHandshake(args));
+
+        Options options = Server.createHandshakeOptions(args);
+        Assert.assertTrue(options.isTunnelForward());
+    }
+
+    @Test
+    public void testCreateHandshakeOptionsMoreRecentClient() {
+        // the version actually used is negotiated in the handshake
+        String[] args = {"handshake=2", "false"};
+        Assert.assertTrue(Server.isHandshake(args));
+
+        Options options = Server.createHandshakeOptions(args);
+        Assert.assertFalse(options.isTunnelForward());
+    }
+
+    @Test(expected = IllegalArgumentException.class)
+    public void testCreateHandshakeOptionsInvalidVersion() {
+        Server.createHandshakeOptions("handshake=0", "true");
+    }
+
+    @Test
+    public void testCreateLegacyOptions() {
+        // the positional arguments of the clients not supporting the handshake
+        String[] args = {"1023", "2000000", "true", "-", "false"};
+        Assert.assertFalse(Server.isHandshake(args));
+
+        Options options = Server.createLegacyOptions(args);
+        Assert.assertEquals(1016, options.getMaxSize());
+        Assert.assertEquals(2000000, options.getBitRate());
+        Assert.assertTrue(options.isTunnelForward());
+        Assert.assertNull(options.getCrop());
+        Assert.assertFalse(options.getSendFrameMeta());
+        Assert.assertEquals(ControlEventReader.PROTOCOL_VERSION_1, options.getControlProtocolVersion());
+        Assert.assertFalse(options.getSquareVideo());
+        Assert.assertEquals(VideoCodec.H264, options.getCodec());
+    }
+
+    @Test(expected = IllegalArgumentException.class)
+    public void testCreateLegacyOptionsWrongCount() {
+        Server.createLegacyOptions("1024", "8000000", "true");
+    }
+}
@@ -0,0 +1,25 @@
+package org.vispo.miralldroid;
+
+import org.junit.Assert;
+import org.junit.Test;
+
+public class VideoCodecTest {
+
+    @Test
+    public void testFindByName() {
+        Assert.assertEquals(VideoCodec.H264, VideoCodec.findByName("h264"));
+        Assert.assertEquals(VideoCodec.H265, VideoCodec.findByName("h265"));
+    }
+
+    @Test(expected = IllegalArgumentException.class)
+    public void testFindUnknownName() {
+        VideoCodec.findByName("vp8");
+    }
+
+    @Test
+    public void testIdsMatchClient() {
+        // enum device_codec in the client
+        Assert.assertEquals(0, VideoCodec.H264.getId());
+        Assert.assertEquals(1, VideoCodec.H265.getId());
+    }
+}